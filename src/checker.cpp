@@ -0,0 +1,222 @@
+/**
+ * @brief Search-free checking of serialized proofs
+ */
+
+#include "checker.hpp"
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+/// Throws unless _node has text _text and _n children
+static void expect(const ASTNode &_node,
+                   const std::string &_text, const size_t &_n) {
+  if (_node.text.text != _text || _node.children.size() != _n) {
+    std::stringstream ss;
+    ss << "Expected (" << _text << " ...) with " << _n
+       << " children, but got " << _node;
+    throw std::runtime_error(ss.str());
+  }
+}
+
+ProofChecker::ProofChecker(const Core &_core) : core(_core) {
+  for (size_t i = 0; i < core.im.rules.size(); ++i) {
+    const auto &name = core.im.rules[i].name;
+    if (name.has_value()) {
+      rule_names.emplace(name.value(), i);
+    }
+  }
+}
+
+const InferenceMaker::InferenceRule &
+ProofChecker::rule(const std::string &_name) const {
+  const auto it = rule_names.find(_name);
+  if (it != rule_names.end()) {
+    return core.im.rules[it->second];
+  }
+
+  // Unnamed rules are written by index
+  if (!_name.empty() &&
+      std::all_of(_name.begin(), _name.end(), ::isdigit)) {
+    const size_t index = std::stoull(_name);
+    if (index < core.im.rules.size()) {
+      return core.im.rules[index];
+    }
+  }
+  throw std::runtime_error("Unknown rule " + _name);
+}
+
+TermId ProofChecker::check_theorem(
+    const ASTNode &_theorem,
+    const std::vector<TermId> &_premises) const {
+  const TermId conclusion =
+      term_store.intern(_theorem.children.at(0));
+  const auto &application = _theorem.children.at(1);
+  expect(application.children.at(0), "rule", 1);
+  const auto &r =
+      rule(application.children.at(0).children.at(0).text.text);
+
+  if (_premises.size() != r.requirements.size()) {
+    throw std::runtime_error(
+        "Rule takes " + std::to_string(r.requirements.size()) +
+        " premises, but was given " +
+        std::to_string(_premises.size()));
+  }
+
+  // The premises bind the rule's variables once, in order
+  Bindings bindings = no_bindings();
+  for (size_t i = 0; i < _premises.size(); ++i) {
+    if (!r.requirement_programs[i].run(_premises[i],
+                                       bindings)) {
+      throw std::runtime_error(
+          "Premise " + term_store.to_string(_premises[i]) +
+          " does not match requirement " +
+          term_store.to_string(r.requirements[i]));
+    }
+  }
+
+  // Usually the conclusion is just an instance of the
+  // consequence
+  Bindings with_conclusion = bindings;
+  if (r.consequence_program.run(conclusion, with_conclusion)) {
+    return conclusion;
+  }
+
+  // Else it was reduced when derived, so reduce it again
+  r.fill_unbound(bindings);
+  const TermId expected = term_store.beta_star(
+      term_store.instantiate(r.consequence_schema, bindings));
+  if (expected != conclusion) {
+    throw std::runtime_error(
+        "Conclusion " + term_store.to_string(conclusion) +
+        " does not follow; expected " +
+        term_store.to_string(expected));
+  }
+  return conclusion;
+}
+
+TermId ProofChecker::check(const ASTNode &_proof) const {
+  if (_proof.text.text != "proof") {
+    throw std::runtime_error("Not a proof");
+  }
+
+  // Steps may only refer to earlier steps, so the proof is a
+  // DAG and each step is checked once
+  std::unordered_map<std::string, TermId> steps;
+  std::optional<TermId> result;
+  for (const auto &child : _proof.children) {
+    if (child.text.text == "result") {
+      expect(child, "result", 1);
+      const auto it = steps.find(child.children[0].text.text);
+      if (it == steps.end()) {
+        throw std::runtime_error("Result is not a step");
+      }
+      result = it->second;
+      continue;
+    }
+
+    expect(child, "step", 2);
+    const std::string id = child.children[0].text.text;
+    const ASTNode &body = child.children[1];
+    if (steps.contains(id)) {
+      throw std::runtime_error("Step " + id + " is repeated");
+    }
+
+    try {
+      TermId thm;
+      if (body.text.text == "axiom") {
+        expect(body, "axiom", 1);
+        thm = term_store.intern(body.children[0]);
+        const int index = core.im.has(thm);
+        if (index < 0 || !core.axioms.contains(index)) {
+          throw std::runtime_error(
+              term_store.to_string(thm) + " is not an axiom");
+        }
+      } else {
+        expect(body, "theorem", 2);
+        expect(body.children[1], "rule_application", 2);
+
+        // A step with no premises writes them as a bare atom
+        const ASTNode &premises = body.children[1].children[1];
+        if (premises.text.text != "premises") {
+          throw std::runtime_error("Expected premises");
+        }
+        std::vector<TermId> premise_terms;
+        for (const auto &premise : premises.children) {
+          const auto it = steps.find(premise.text.text);
+          if (it == steps.end()) {
+            throw std::runtime_error("Premise " +
+                                     premise.text.text +
+                                     " is not an earlier step");
+          }
+          premise_terms.push_back(it->second);
+        }
+        thm = check_theorem(body, premise_terms);
+      }
+      steps.emplace(id, thm);
+    } catch (const std::runtime_error &e) {
+      throw std::runtime_error("Step " + id + ": " + e.what());
+    }
+  }
+
+  if (!result.has_value()) {
+    throw std::runtime_error("Proof has no result");
+  }
+  return result.value();
+}
+
+std::vector<ASTNode>
+ProofChecker::read(const std::string &_text) {
+  std::vector<ASTNode> out;
+
+  // The nodes whose closing parentheses are still to come
+  std::vector<ASTNode> open;
+  size_t i = 0;
+  while (i < _text.size()) {
+    const char c = _text[i];
+    if (std::isspace((unsigned char)c)) {
+      ++i;
+      continue;
+    }
+
+    if (c == ')') {
+      if (open.empty()) {
+        throw std::runtime_error("Unbalanced ')' in proof");
+      }
+      ASTNode done = std::move(open.back());
+      open.pop_back();
+      (open.empty() ? out : open.back().children)
+          .push_back(std::move(done));
+      ++i;
+      continue;
+    }
+
+    // An atom, or the head of a new node
+    const bool is_node = c == '(';
+    if (is_node) {
+      ++i;
+    }
+    const size_t start = i;
+    while (i < _text.size() &&
+           !std::isspace((unsigned char)_text[i]) &&
+           _text[i] != '(' && _text[i] != ')') {
+      ++i;
+    }
+    if (start == i) {
+      throw std::runtime_error("Expected a head after '('");
+    }
+    ASTNode atom(_text.substr(start, i - start));
+    if (is_node) {
+      open.push_back(std::move(atom));
+    } else {
+      (open.empty() ? out : open.back().children)
+          .push_back(std::move(atom));
+    }
+  }
+
+  if (!open.empty()) {
+    throw std::runtime_error("Unbalanced '(' in proof");
+  }
+  return out;
+}
@@ -0,0 +1,49 @@
+/**
+ * @brief Search-free checking of serialized proofs
+ */
+
+#pragma once
+
+#include "core.hpp"
+#include "term.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Replays proofs in the form written by Core::write_proof_dag
+/// against the rules and axioms of a Core. Each step is checked
+/// by matching its rule against its premises and conclusion
+/// once, so checking takes time linear in the size of the proof
+/// and never searches.
+class ProofChecker {
+public:
+  /// Checks against the rules _core has now, and the axioms it
+  /// has whenever check is called
+  ProofChecker(const Core &_core);
+
+  /// Checks a (proof (step ...) ... (result ...)) node and
+  /// returns the theorem it proves. Throws a runtime_error
+  /// describing the first bad step.
+  TermId check(const ASTNode &_proof) const;
+
+  /// Reads every s-expression in _text, as printed by
+  /// operator<< on ASTNode
+  static std::vector<ASTNode> read(const std::string &_text);
+
+protected:
+  /// Checks a single (theorem ...) step whose premises have
+  /// the given terms, returning its conclusion
+  TermId
+  check_theorem(const ASTNode &_theorem,
+                const std::vector<TermId> &_premises) const;
+
+  /// Finds the rule a proof refers to by name or index
+  const InferenceMaker::InferenceRule &
+  rule(const std::string &_name) const;
+
+  /// The core whose rules and axioms are trusted
+  const Core &core;
+
+  /// The index of each named rule
+  std::unordered_map<std::string, size_t> rule_names;
+};
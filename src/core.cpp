@@ -1,6 +1,21 @@
 #include "core.hpp"
 #include "inference.hpp"
-#include <functional>
+#include "snapshot.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+/// Hashes _text with 64-bit FNV-1a, continuing from _hash
+static uint64_t
+fnv1a(const std::string &_text,
+      uint64_t _hash = 0xcbf29ce484222325ull) {
+  for (const auto &c : _text) {
+    _hash = (_hash ^ (uint8_t)c) * 0x100000001b3ull;
+  }
+  return _hash;
+}
 
 std::string Core::sanitize_name(const std::string &_s) {
   std::string out;
@@ -13,182 +28,274 @@ std::string Core::sanitize_name(const std::string &_s) {
   return out;
 }
 
-ASTNode Core::proof_to_ast(const size_t &_thm_index) const {
+void Core::report_failure(const ASTNode &_stmt) {
+  saw_error = true;
+  std::cerr << "ERROR:   Failed to prove "
+            << _stmt.children.front();
+  switch (im.limit_hit.load()) {
+  case InferenceMaker::TIME_LIMIT:
+    std::cerr << " (out of time)";
+    break;
+  case InferenceMaker::THEOREM_LIMIT:
+    std::cerr << " (too many theorems derived)";
+    break;
+  case InferenceMaker::NODE_LIMIT:
+    std::cerr << " (too many goals examined)";
+    break;
+  case InferenceMaker::MEMORY_LIMIT:
+    std::cerr << " (out of memory)";
+    break;
+  case InferenceMaker::NO_LIMIT:
+    break;
+  }
+  std::cerr << "\n";
+}
+
+void Core::write_proof(std::ostream &_strm,
+                       const size_t &_thm_index) const {
   const auto thm = im.get_theorem(_thm_index);
   if (thm.rule_index < 0) {
-    return ASTNode("axiom", {thm.thm});
+    _strm << "(axiom ";
+    term_store.print(_strm, thm.thm);
+    _strm << ")";
+    return;
+  }
+
+  const auto rule = im.get_rule(thm.rule_index);
+  _strm << "(theorem ";
+  term_store.print(_strm, thm.thm);
+  _strm << " (rule_application (rule "
+        << rule.name.value_or(std::to_string(thm.rule_index))
+        << ") ";
+  if (thm.premises.empty()) {
+    _strm << "premises";
   } else {
-    ASTNode premises_block("premises");
+    _strm << "(premises";
     for (const auto &premise : thm.premises) {
-      premises_block.children.push_back(proof_to_ast(premise));
+      _strm << " ";
+      write_proof(_strm, premise);
     }
-
-    const auto rule = im.get_rule(thm.rule_index);
-    const std::string rule_name =
-        rule.name.value_or(std::to_string(thm.rule_index));
-
-    return ASTNode(
-        "theorem",
-        {thm.thm,
-         ASTNode("rule_application",
-                 {ASTNode("rule", {ASTNode(rule_name)}),
-                  premises_block})});
+    _strm << ")";
   }
+  _strm << "))";
 }
 
-/// Prints the rules, axioms, and selected theorems in latex
-/// 'inferrule' notation
-void Core::latex(std::ostream &_strm) const {
-  // Print an AST in latex notation (EG 'and' -> '\land')
-  const std::function<void(const ASTNode &)> print_ast_latex =
-      [&](const ASTNode &_what) -> void {
-    const auto t = _what.text;
-
-    // Normal PL stuff
-    if (t == "and") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " \\land ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "or") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " \\lor ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "not") {
-      _strm << " \\lnot ";
-      print_ast_latex(_what.children.at(0));
-    } else if (t == "implies") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " \\implies ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "iff") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " \\iff ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "in") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " \\in ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "==") {
-      _strm << "(";
-      print_ast_latex(_what.children.at(0));
-      _strm << " = ";
-      print_ast_latex(_what.children.at(1));
-      _strm << ")";
-    } else if (t == "prime") {
-      print_ast_latex(_what.children.at(0));
-      _strm << "' ";
+void Core::write_proof_dag(std::ostream &_strm,
+                           const size_t &_thm_index) const {
+  std::unordered_map<size_t, size_t> step_ids;
+  _strm << "(proof";
+
+  // Depth-first, numbering each theorem once all of its
+  // premises have been. The bool is true once its premises
+  // have been pushed.
+  std::vector<std::pair<size_t, bool>> stack = {
+      {_thm_index, false}};
+  while (!stack.empty()) {
+    const auto [index, expanded] = stack.back();
+    if (step_ids.contains(index)) {
+      stack.pop_back();
+      continue;
     }
 
-    // Math
-    else if (t == "^") {
-      _strm << "{";
-      print_ast_latex(_what.children.at(0));
-      _strm << "}^{";
-      print_ast_latex(_what.children.at(1));
-      _strm << "}";
+    const auto thm = im.get_theorem(index);
+    if (!expanded) {
+      stack.back().second = true;
+      for (auto it = thm.premises.rbegin();
+           it != thm.premises.rend(); ++it) {
+        if (!step_ids.contains(*it)) {
+          stack.push_back({*it, false});
+        }
+      }
+      continue;
+    }
+    stack.pop_back();
+
+    const size_t id = step_ids.size();
+    step_ids[index] = id;
+    _strm << " (step " << id << " ";
+    if (thm.rule_index < 0) {
+      _strm << "(axiom ";
+      term_store.print(_strm, thm.thm);
+      _strm << "))";
+      continue;
     }
 
-    // Quantification
-    else if (t == "forall") {
-      _strm << "( \\forall ";
-      print_ast_latex(_what.children.at(0));
-      _strm << " . ";
-      print_ast_latex(_what.children.at(1));
-      _strm << " )";
-    } else if (t == "exists") {
-      _strm << "( \\exists ";
-      print_ast_latex(_what.children.at(0));
-      _strm << " . ";
-      print_ast_latex(_what.children.at(1));
-      _strm << " )";
-    } else if (t == "REPLACE") {
-      /*
-      const auto A = children.at(0);
-      const auto x = children.at(1);
-      const auto B = children.at(2);
-      return A.replace(x, B).beta_star();
-      */
-      print_ast_latex(_what.children.at(0));
-      _strm << " [ ";
-      print_ast_latex(_what.children.at(1));
-      _strm << " := ";
-      print_ast_latex(_what.children.at(2));
-      _strm << " ]";
+    const auto rule = im.get_rule(thm.rule_index);
+    _strm << "(theorem ";
+    term_store.print(_strm, thm.thm);
+    _strm << " (rule_application (rule "
+          << rule.name.value_or(std::to_string(thm.rule_index))
+          << ") ";
+    if (thm.premises.empty()) {
+      _strm << "premises";
+    } else {
+      _strm << "(premises";
+      for (const auto &premise : thm.premises) {
+        _strm << " " << step_ids.at(premise);
+      }
+      _strm << ")";
     }
+    _strm << ")))";
+  }
 
-    // Proof stuff
-    else if (t == "axiom") {
-      const auto axiom = _what.children.at(0);
-      _strm << "\\inferrule*[right=axiom]{\\,}{\n";
-      print_ast_latex(axiom);
-      _strm << "\n}";
-    } else if (t == "theorem") {
-      const auto thm = _what.children.at(0);
-      const auto rule_app = _what.children.at(1);
-      const std::string rule_name =
-          rule_app.children.at(0).children.at(0).text.text;
-      const auto premises = rule_app.children.at(1);
-
-      _strm << "\\inferrule*[right=" << sanitize_name(rule_name)
-            << "]{";
-      bool first = true;
-      for (const auto &premise : premises.children) {
-        if (first) {
-          first = false;
-        } else {
-          _strm << "\n";
-        }
-        print_ast_latex(premise);
+  _strm << " (result " << step_ids.at(_thm_index) << "))";
+}
+
+void Core::write_term_latex(std::ostream &_strm,
+                            const TermId &_what) const {
+  const std::string &t = term_store.text(_what);
+  const auto span = term_store.children(_what);
+  const std::vector<TermId> children(span.begin(), span.end());
+
+  // Normal PL stuff
+  if (t == "and") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " \\land ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "or") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " \\lor ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "not") {
+    _strm << " \\lnot ";
+    write_term_latex(_strm, children.at(0));
+  } else if (t == "implies") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " \\implies ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "iff") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " \\iff ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "in") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " \\in ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "==") {
+    _strm << "(";
+    write_term_latex(_strm, children.at(0));
+    _strm << " = ";
+    write_term_latex(_strm, children.at(1));
+    _strm << ")";
+  } else if (t == "prime") {
+    write_term_latex(_strm, children.at(0));
+    _strm << "' ";
+  }
+
+  // Math
+  else if (t == "^") {
+    _strm << "{";
+    write_term_latex(_strm, children.at(0));
+    _strm << "}^{";
+    write_term_latex(_strm, children.at(1));
+    _strm << "}";
+  }
+
+  // Quantification
+  else if (t == "forall") {
+    _strm << "( \\forall ";
+    write_term_latex(_strm, children.at(0));
+    _strm << " . ";
+    write_term_latex(_strm, children.at(1));
+    _strm << " )";
+  } else if (t == "exists") {
+    _strm << "( \\exists ";
+    write_term_latex(_strm, children.at(0));
+    _strm << " . ";
+    write_term_latex(_strm, children.at(1));
+    _strm << " )";
+  } else if (t == "REPLACE") {
+    /*
+    const auto A = children.at(0);
+    const auto x = children.at(1);
+    const auto B = children.at(2);
+    return A.replace(x, B).beta_star();
+    */
+    write_term_latex(_strm, children.at(0));
+    _strm << " [ ";
+    write_term_latex(_strm, children.at(1));
+    _strm << " := ";
+    write_term_latex(_strm, children.at(2));
+    _strm << " ]";
+  }
+
+  // Default case: Just print the s-expr itself.
+  else if (t == "_") {
+    // List
+    _strm << "(";
+    bool first = true;
+    for (const auto &child : children) {
+      if (first) {
+        first = false;
+      } else {
+        _strm << ", ";
       }
+      write_term_latex(_strm, child);
+    }
+    _strm << ")";
+  } else if (children.empty()) {
+    _strm << "\\texttt{" << sanitize_name(t) << "}";
+  } else {
+    _strm << "\\texttt{" << sanitize_name(t) << "}(";
+    bool first = true;
+    for (const auto &child : children) {
       if (first) {
-        _strm << "\\,";
+        first = false;
+      } else {
+        _strm << ", ";
       }
-      _strm << "}{\n";
-      print_ast_latex(thm);
-      _strm << "\n}";
+      write_term_latex(_strm, child);
     }
+    _strm << ")";
+  }
+}
 
-    // Default case: Just print the s-expr itself.
-    else if (t == "_") {
-      // List
-      _strm << "(";
-      bool first = true;
-      for (const auto &child : _what.children) {
-        if (first) {
-          first = false;
-        } else {
-          _strm << ", ";
-        }
-        print_ast_latex(child);
-      }
-      _strm << ")";
-    } else if (_what.children.empty()) {
-      _strm << "\\texttt{" << sanitize_name(t.text) << "}";
+void Core::write_proof_latex(std::ostream &_strm,
+                             const size_t &_thm_index) const {
+  const auto thm = im.get_theorem(_thm_index);
+  if (thm.rule_index < 0) {
+    _strm << "\\inferrule*[right=axiom]{\\,}{\n";
+    write_term_latex(_strm, thm.thm);
+    _strm << "\n}";
+    return;
+  }
+
+  const auto rule = im.get_rule(thm.rule_index);
+  const std::string rule_name =
+      rule.name.value_or(std::to_string(thm.rule_index));
+
+  _strm << "\\inferrule*[right=" << sanitize_name(rule_name)
+        << "]{";
+  bool first = true;
+  for (const auto &premise : thm.premises) {
+    if (first) {
+      first = false;
     } else {
-      _strm << "\\texttt{" << sanitize_name(t.text) << "}(";
-      bool first = true;
-      for (const auto &child : _what.children) {
-        if (first) {
-          first = false;
-        } else {
-          _strm << ", ";
-        }
-        print_ast_latex(child);
-      }
-      _strm << ")";
+      _strm << "\n";
     }
-  };
+    write_proof_latex(_strm, premise);
+  }
+  if (first) {
+    _strm << "\\,";
+  }
+  _strm << "}{\n";
+  write_term_latex(_strm, thm.thm);
+  _strm << "\n}";
+}
 
+/// Prints the rules, axioms, and selected theorems in latex
+/// 'inferrule' notation
+void Core::latex(std::ostream &_strm) const {
   _strm << "\\documentclass{article}\n"
            "\\usepackage{amsmath}\n"
            "\\usepackage{amssymb}\n"
@@ -202,13 +309,13 @@ void Core::latex(std::ostream &_strm) const {
     if (!rule.free_variables.empty()) {
       _strm << "For generic";
       bool first = true;
-      for (const auto &fv : rule.free_variables) {
+      for (const auto &fv : rule.free_variables_by_name()) {
         if (first) {
           first = false;
         } else {
           _strm << ",";
         }
-        _strm << " \\texttt{" << fv << "}";
+        _strm << " \\texttt{" << symbols.text(fv) << "}";
       }
       _strm << ":\n\n";
     }
@@ -228,7 +335,7 @@ void Core::latex(std::ostream &_strm) const {
       } else {
         _strm << "\n\\\\\n";
       }
-      print_ast_latex(premise);
+      write_term_latex(_strm, premise);
     }
     if (first) {
       _strm << "\\,";
@@ -237,7 +344,7 @@ void Core::latex(std::ostream &_strm) const {
     _strm << "}{\n";
 
     // Consequence
-    print_ast_latex(rule.consequence);
+    write_term_latex(_strm, rule.consequence);
 
     _strm << "  }\n"
              "\\]\n\n";
@@ -247,7 +354,7 @@ void Core::latex(std::ostream &_strm) const {
 
   for (const auto &axiom : axioms) {
     _strm << "\\[\n";
-    print_ast_latex(proof_to_ast(axiom));
+    write_proof_latex(_strm, axiom);
     _strm << "\n\\]\n\n";
   }
 
@@ -255,7 +362,7 @@ void Core::latex(std::ostream &_strm) const {
 
   for (const auto &theorem : proven_theorems) {
     _strm << "\\[\n";
-    print_ast_latex(proof_to_ast(theorem));
+    write_proof_latex(_strm, theorem);
     _strm << "\n\\]\n\n";
   }
 
@@ -269,10 +376,17 @@ void Core::process_statement(
     std::cout << "On stmt " << _stmt << "\n\n";
   }
 
+  // Only the include cache needs to tell states apart
+  if (!include_cache.empty()) {
+    std::stringstream text;
+    text << _stmt;
+    state_hash = fnv1a(text.str(), state_hash);
+  }
+
   // Rule
   if (_stmt.text == Token("RULE")) {
     // (RULE (OVER x y z) (GIVEN fee fi fo) (DEDUCE
-    // fum fli foo flib))
+    // fum fli foo flib) name [cost])
     const auto over = _stmt.children.at(0);
     const auto given = _stmt.children.at(1);
     const auto consequence =
@@ -293,6 +407,15 @@ void Core::process_statement(
     if (name != "NULL") {
       ir.name = name;
     }
+    if (_stmt.children.size() > 4) {
+      const std::string cost = _stmt.children.at(4).text.text;
+      if (cost.empty() ||
+          !std::all_of(cost.begin(), cost.end(), ::isdigit)) {
+        throw std::runtime_error("Rule cost '" + cost +
+                                 "' is not a number");
+      }
+      ir.cost = std::stoull(cost);
+    }
 
     im.add_rule(ir);
   }
@@ -300,14 +423,24 @@ void Core::process_statement(
   // Thing to prove
   else if (_stmt.text == Token("PROVE_FORWARD")) {
     // (THEOREM to_prove)
+    if (check_only) {
+      return;
+    }
+    if (!global_limits) {
+      im.start_limits();
+    }
+    // The pass limit bounds both the rounds of alternation and
+    // how deep each backward round goes
+    const auto what = term_store.intern(_stmt.children.front());
     const auto res =
-        im.forward_prove(_stmt.children.front(), pass_limit);
+        im.enable_alternation
+            ? im.alternate_prove(what, pass_limit, pass_limit,
+                                 true)
+            : im.forward_prove(what, pass_limit);
     if (res.has_value()) {
       proven_theorems.insert(res.value().index);
     } else {
-      saw_error = true;
-      std::cerr << "ERROR:   Failed to prove "
-                << _stmt.children.front() << "\n";
+      report_failure(_stmt);
     }
   }
 
@@ -318,21 +451,33 @@ void Core::process_statement(
   else if (_stmt.text == Token("PROVE_BACKWARD") ||
            _stmt.text == Token("THEOREM")) {
     // (THEOREM to_prove)
+    if (check_only) {
+      return;
+    }
+    if (!global_limits) {
+      im.start_limits();
+    }
+    const auto what = term_store.intern(_stmt.children.front());
     const auto res =
-        im.backward_prove(_stmt.children.front(), pass_limit);
+        im.enable_alternation
+            ? im.alternate_prove(what, pass_limit, pass_limit,
+                                 false)
+        : best_first     ? im.best_first_prove(what, pass_limit)
+        : deepen         ? im.deepening_prove(what, pass_limit)
+        : im.threads > 1 ? im.parallel_prove(what, pass_limit)
+                         : im.backward_prove(what, pass_limit);
     if (res.has_value()) {
       proven_theorems.insert(res.value().index);
     } else {
-      saw_error = true;
-      std::cerr << "ERROR:   Failed to prove "
-                << _stmt.children.front() << "\n";
+      report_failure(_stmt);
     }
   }
 
   // Axiom
   else if (_stmt.text == Token("AXIOM")) {
     // (AXIOM a)
-    const size_t index = im.add_axiom(_stmt.children.front());
+    const size_t index =
+        im.add_axiom(term_store.intern(_stmt.children.front()));
     axioms.insert(index);
   }
 
@@ -342,7 +487,7 @@ void Core::process_statement(
     const auto written = _stmt.children.front().text.text;
     const auto path = std::filesystem::absolute(
         _cur_path.parent_path() / written);
-    do_file(path);
+    include_file(path);
   }
 
   // Functions
@@ -401,8 +546,45 @@ void Core::process_statement(
   }
 }
 
+std::string Core::read_file(const std::filesystem::path &_fp) {
+  std::ifstream f(_fp, std::ios::binary);
+  if (!f.is_open()) {
+    throw std::runtime_error("Failed to open " + _fp.string());
+  }
+  std::stringstream contents;
+  contents << f.rdbuf();
+  return contents.str();
+}
+
+Core::FileKey
+Core::file_key(const std::filesystem::path &_fp,
+               const std::string &_contents) {
+  return {std::filesystem::canonical(_fp).string(),
+          fnv1a(_contents)};
+}
+
+bool Core::log_file(const FileKey &_key) {
+  file_log.push_back(_key);
+  state_hash = fnv1a(_key.first, state_hash ^ _key.second);
+  return included_files.insert(_key).second;
+}
+
 void Core::do_file(const std::filesystem::path &_fp) {
-  Parser p(lex_file(_fp));
+  const std::string contents = read_file(_fp);
+  do_file(_fp, file_key(_fp, contents), contents);
+}
+
+void Core::do_file(const std::filesystem::path &_fp,
+                   const FileKey &_key,
+                   const std::string &_contents) {
+  if (!log_file(_key)) {
+    if (debug) {
+      std::cout << "Already did " << _key.first << "\n\n";
+    }
+    return;
+  }
+
+  Parser p(lex_file_text(_contents, _fp));
   p.debug = debug;
   const auto root = p.parse();
 
@@ -414,3 +596,65 @@ void Core::do_file(const std::filesystem::path &_fp) {
     process_statement(stmt, _fp);
   }
 }
+
+void Core::include_file(const std::filesystem::path &_fp) {
+  const std::string contents = read_file(_fp);
+  const FileKey key = file_key(_fp, contents);
+  // Theorems are skipped when only checking, so what such a
+  // run learns must not be cached
+  if (include_cache.empty() || check_only ||
+      included_files.contains(key)) {
+    do_file(_fp, key, contents);
+    return;
+  }
+
+  // The same contents from the same state always lead to the
+  // same place. Rather than hashing all the state, this hashes
+  // how it was reached.
+  std::stringstream state;
+  state << state_hash << " " << im.rules.size() << " "
+        << im.known.size() << " " << key.first;
+  const uint64_t after = fnv1a(state.str(), key.second);
+  std::stringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0')
+       << after;
+  const auto entry = include_cache / (name.str() + ".snap");
+
+  // The snapshot lists each file which was done (or skipped)
+  // while doing this one, and all must be unchanged
+  bool hit = std::filesystem::exists(entry);
+  try {
+    for (const auto &dep :
+         hit ? snapshot_files(entry) : std::vector<FileKey>()) {
+      if (dep != key &&
+          file_key(dep.first, read_file(dep.first)) != dep) {
+        hit = false;
+        break;
+      }
+    }
+  } catch (const std::exception &) {
+    hit = false;
+  }
+
+  if (hit) {
+    if (debug) {
+      std::cout << "Using cached " << entry << "\n\n";
+    }
+    load_snapshot(*this, entry);
+  } else {
+    const size_t first_rule = im.rules.size();
+    const size_t first_theorem = im.known.size();
+    const size_t first_file = file_log.size();
+    do_file(_fp, key, contents);
+
+    // A failure might not fail next time, so it is not cached
+    if (!saw_error) {
+      std::filesystem::create_directories(include_cache);
+      save_snapshot(*this, entry, first_rule, first_theorem,
+                    first_file);
+    }
+  }
+
+  // Either way ends in the same state
+  state_hash = after;
+}
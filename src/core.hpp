@@ -12,8 +12,28 @@ public:
   /// Turns all underscores to spaces
   static std::string sanitize_name(const std::string &_s);
 
-  /// Turns a proof as internally represented into an AST node
-  ASTNode proof_to_ast(const size_t &_thm_index) const;
+  /// Writes a proof as a tree of nested (axiom ...) and
+  /// (theorem ... (rule_application (rule ...) (premises ...)))
+  /// nodes, straight from the theorems
+  void write_proof(std::ostream &_strm,
+                   const size_t &_thm_index) const;
+
+  /// Writes a proof as a DAG, where each theorem it uses is one
+  /// numbered step and premises are referred to by number:
+  /// (proof (step 0 (axiom ...)) (step 1 (theorem ...
+  /// (rule_application (rule ...) (premises 0)))) (result 1)).
+  /// Steps come after their premises, and the output is linear
+  /// in the number of distinct theorems used.
+  void write_proof_dag(std::ostream &_strm,
+                       const size_t &_thm_index) const;
+
+  /// Writes a term in latex notation (EG 'and' -> '\land')
+  void write_term_latex(std::ostream &_strm,
+                        const TermId &_what) const;
+
+  /// Writes a proof as nested latex 'inferrule's
+  void write_proof_latex(std::ostream &_strm,
+                         const size_t &_thm_index) const;
 
   /// Prints the rules, axioms, and selected theorems in latex
   /// 'inferrule' notation
@@ -24,15 +44,61 @@ public:
   process_statement(const ASTNode &_stmt,
                     const std::filesystem::path &_cur_path);
 
-  /// Do a file, executing each statement sequentially
+  /// Reports that a proof statement failed, and which resource
+  /// limit stopped it if any
+  void report_failure(const ASTNode &_stmt);
+
+  /// Do a file, executing each statement sequentially. A file
+  /// whose path and contents have already been done this run is
+  /// skipped.
   void do_file(const std::filesystem::path &_fp);
 
+  /// Do an included file. If include_cache is set and a past
+  /// run included the same contents from the same state, this
+  /// loads what that run learned instead. The cache is neither
+  /// read nor written when check_only is set.
+  void include_file(const std::filesystem::path &_fp);
+
+  /// A file's canonical path and the hash of its contents
+  using FileKey = std::pair<std::string, uint64_t>;
+
+  /// Reads a whole file, throwing if it cannot be read
+  static std::string
+  read_file(const std::filesystem::path &_fp);
+
+  /// Gets the key of a file whose contents are _contents
+  static FileKey file_key(const std::filesystem::path &_fp,
+                          const std::string &_contents);
+
+  /// Does a file which has already been read, and whose key is
+  /// _key
+  void do_file(const std::filesystem::path &_fp,
+               const FileKey &_key,
+               const std::string &_contents);
+
+  /// Notes that the file with key _key was done (or skipped),
+  /// returning false if it had been done already
+  bool log_file(const FileKey &_key);
+
   InferenceMaker im;
   bool saw_error = false;
   bool debug = false;
   bool time = false;
   bool print_latex = false;
+  bool deepen = false;
+  bool best_first = false;
+  bool global_limits = false;
+  bool dag_proofs = false;
+  bool check_only = false;
   uintmax_t pass_limit = 64;
   std::set<size_t> axioms;
   std::set<size_t> proven_theorems;
+  std::set<FileKey> included_files;
+  std::vector<FileKey> file_log;
+
+  /// A hash of the files and statements done so far, kept up to
+  /// date as they are done so that the include cache can tell
+  /// states apart without looking at what they know
+  uint64_t state_hash = 0;
+  std::filesystem::path include_cache;
 };
@@ -0,0 +1,131 @@
+/**
+ * @brief Term indexing implementation
+ */
+
+#include "index.hpp"
+#include <algorithm>
+
+DiscriminationTree::DiscriminationTree() : nodes(1) {
+}
+
+uint64_t
+DiscriminationTree::key(const SymbolId &_symbol,
+                        const uint32_t &_arity) noexcept {
+  return ((uint64_t)_symbol << 32) | _arity;
+}
+
+void DiscriminationTree::insert(
+    const TermId &_pattern,
+    const std::set<SymbolId> &_variables,
+    const size_t &_value) {
+  uint32_t cur = 0;
+  std::vector<TermId> pending = {_pattern};
+  while (!pending.empty()) {
+    const TermId t = pending.back();
+    pending.pop_back();
+
+    if (_variables.contains(term_store.head(t))) {
+      // Wildcard: do not descend
+      if (nodes[cur].wildcard == 0) {
+        nodes[cur].wildcard = nodes.size();
+        nodes.emplace_back();
+      }
+      cur = nodes[cur].wildcard;
+      continue;
+    }
+
+    const auto children = term_store.children(t);
+    const uint64_t k = key(term_store.head(t), children.size());
+    const auto it = nodes[cur].children.find(k);
+    if (it != nodes[cur].children.end()) {
+      cur = it->second;
+    } else {
+      const uint32_t next = nodes.size();
+      nodes[cur].children.insert({k, next});
+      nodes.emplace_back();
+      cur = next;
+    }
+
+    // Children are pushed in reverse so the first is next
+    pending.insert(pending.end(), children.rbegin(),
+                   children.rend());
+  }
+  nodes[cur].values.push_back(_value);
+}
+
+std::vector<size_t>
+DiscriminationTree::retrieve_generalizations(
+    const TermId &_term) const {
+  return retrieve_unifiable(_term, {});
+}
+
+std::vector<size_t> DiscriminationTree::retrieve_unifiable(
+    const TermId &_query,
+    const std::set<SymbolId> &_variables) const {
+  std::vector<size_t> out;
+  std::vector<TermId> pending = {_query};
+  unifiable(0, pending, _variables, out);
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+  return out;
+}
+
+void DiscriminationTree::unifiable(
+    const uint32_t &_node, std::vector<TermId> &_pending,
+    const std::set<SymbolId> &_variables,
+    std::vector<size_t> &_out) const {
+  const Node &n = nodes[_node];
+  if (_pending.empty()) {
+    _out.insert(_out.end(), n.values.begin(), n.values.end());
+    return;
+  }
+
+  const TermId t = _pending.back();
+  _pending.pop_back();
+
+  const SymbolId head = term_store.head(t);
+  if (_variables.contains(head) ||
+      symbols.variable_index(head) >= 0) {
+    // A query wildcard swallows an entire stored subterm
+    std::vector<uint32_t> after;
+    skip_terms(_node, 1, after);
+    for (const auto &next : after) {
+      unifiable(next, _pending, _variables, _out);
+    }
+  } else {
+    // A stored wildcard swallows this entire query subterm
+    if (n.wildcard != 0) {
+      unifiable(n.wildcard, _pending, _variables, _out);
+    }
+
+    // Otherwise, the head and arity must match exactly
+    const auto children = term_store.children(t);
+    const auto it = n.children.find(key(head, children.size()));
+    if (it != n.children.end()) {
+      _pending.insert(_pending.end(), children.rbegin(),
+                      children.rend());
+      unifiable(it->second, _pending, _variables, _out);
+      _pending.resize(_pending.size() - children.size());
+    }
+  }
+
+  _pending.push_back(t);
+}
+
+void DiscriminationTree::skip_terms(
+    const uint32_t &_node, const uint32_t &_remaining,
+    std::vector<uint32_t> &_out) const {
+  if (_remaining == 0) {
+    _out.push_back(_node);
+    return;
+  }
+
+  const Node &n = nodes[_node];
+  if (n.wildcard != 0) {
+    skip_terms(n.wildcard, _remaining - 1, _out);
+  }
+  for (const auto &[k, child] : n.children) {
+    // The low half of the key is the arity
+    skip_terms(child, _remaining - 1 + (uint32_t)k, _out);
+  }
+}
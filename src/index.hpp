@@ -0,0 +1,76 @@
+/**
+ * @brief Term indexing for fast rule and theorem retrieval
+ */
+
+#pragma once
+
+#include "symbol.hpp"
+#include "term.hpp"
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/// A discrimination tree: a trie over the preorder traversal of
+/// terms, where the subterms headed by free variables are
+/// collapsed into wildcards. This over-approximates matching,
+/// so anything it returns must still be checked.
+class DiscriminationTree {
+public:
+  /// Constructs an empty tree
+  DiscriminationTree();
+
+  /// Stores _value under _pattern, where any subterm whose head
+  /// is in _variables is a wildcard
+  void insert(const TermId &_pattern,
+              const std::set<SymbolId> &_variables,
+              const size_t &_value);
+
+  /// Returns the values (sorted and unique) of every stored
+  /// pattern which could possibly match the given term
+  std::vector<size_t>
+  retrieve_generalizations(const TermId &_term) const;
+
+  /// Returns the values (sorted and unique) of every stored
+  /// term which could possibly unify with _query, where any
+  /// subterm of _query whose head is in _variables or is a
+  /// numbered variable symbol (see SymbolTable::variable) is a
+  /// wildcard. Bound variables should be substituted into
+  /// _query beforehand to narrow the results.
+  std::vector<size_t> retrieve_unifiable(
+      const TermId &_query,
+      const std::set<SymbolId> &_variables) const;
+
+protected:
+  /// A single trie node
+  struct Node {
+    /// Children keyed on (symbol, arity)
+    std::unordered_map<uint64_t, uint32_t> children;
+
+    /// The wildcard child, or 0 if there is none
+    uint32_t wildcard = 0;
+
+    /// The values stored at this node
+    std::vector<size_t> values;
+  };
+
+  /// Packs a symbol and an arity into a child key
+  static uint64_t key(const SymbolId &_symbol,
+                      const uint32_t &_arity) noexcept;
+
+  /// Recursive helper for retrieval. _pending holds the query
+  /// subterms yet to be consumed, in reverse order.
+  void unifiable(const uint32_t &_node,
+                 std::vector<TermId> &_pending,
+                 const std::set<SymbolId> &_variables,
+                 std::vector<size_t> &_out) const;
+
+  /// Collects every node reached from _node after consuming
+  /// _remaining complete stored terms
+  void skip_terms(const uint32_t &_node,
+                  const uint32_t &_remaining,
+                  std::vector<uint32_t> &_out) const;
+
+  /// All nodes. Index 0 is the root.
+  std::vector<Node> nodes;
+};
@@ -3,35 +3,37 @@
  */
 
 #include "inference.hpp"
+#include <algorithm>
 #include <cassert>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <queue>
 #include <stdexcept>
+#include <tuple>
+#include <unistd.h>
 #include <vector>
 
 std::optional<InferenceMaker::InferenceRule>
 InferenceMaker::InferenceRule::remove_first_req(
-    const ASTNode &_sub) const noexcept {
-  std::set<ASTNode> new_fv = free_variables;
-  std::list<std::pair<ASTNode, ASTNode>> subs;
+    const TermId &_sub) const noexcept {
+  std::set<SymbolId> new_fv = free_variables;
+  std::list<std::pair<TermId, TermId>> subs;
 
   // If not a valid replacement, return none
   if (!is_of_form(_sub, requirements.front(), new_fv, subs)) {
     return {};
   }
 
-  std::list<ASTNode> new_reqs;
-  bool first = true;
-  for (const auto &req : requirements) {
-    if (first) {
-      first = false;
-    } else {
-      new_reqs.push_back(req.replace(subs));
-    }
+  std::vector<TermId> new_reqs;
+  for (uint i = 1; i < requirements.size(); ++i) {
+    new_reqs.push_back(
+        term_store.replace(requirements.at(i), subs));
   }
 
   // Else, adjust and return accordingly
   return InferenceRule(new_fv, new_reqs,
-                       consequence.replace(subs));
+                       term_store.replace(consequence, subs));
 }
 
 const InferenceMaker::InferenceRule
@@ -45,6 +47,7 @@ InferenceMaker::get_rule(const uint &_index) const {
 
 const InferenceMaker::Theorem
 InferenceMaker::get_theorem(const uint &_index) const {
+  std::shared_lock lock(known_mutex);
   if (_index >= known.size()) {
     throw std::runtime_error("Invalid theorem index " +
                              std::to_string(_index));
@@ -53,9 +56,9 @@ InferenceMaker::get_theorem(const uint &_index) const {
 }
 
 bool InferenceMaker::is_of_form(
-    const ASTNode &_to_examine, const ASTNode &_form,
-    std::set<ASTNode> &_free_variables,
-    std::list<std::pair<ASTNode, ASTNode>> &_substitutions) {
+    const TermId &_to_examine, const TermId &_form,
+    std::set<SymbolId> &_free_variables,
+    std::list<std::pair<TermId, TermId>> &_substitutions) {
   // Existing replacements
   for (const auto &p : _substitutions) {
     if (p.first == _form) {
@@ -64,22 +67,26 @@ bool InferenceMaker::is_of_form(
   }
 
   // New replacement
-  if (_free_variables.contains(_form)) {
+  const SymbolId form_head = term_store.head(_form);
+  if (_free_variables.contains(form_head)) {
     _substitutions.push_back({_form, _to_examine});
-    _free_variables.erase(_form);
+    _free_variables.erase(form_head);
     return true;
   }
 
   // Else, _form is not a free variable directly. Recurse like
   // a funky equality
-  if (_to_examine.text != _form.text ||
-      _to_examine.children.size() != _form.children.size()) {
+  const auto examined_children =
+      term_store.children(_to_examine);
+  const auto form_children = term_store.children(_form);
+  if (term_store.head(_to_examine) != form_head ||
+      examined_children.size() != form_children.size()) {
     return false;
   }
-  for (uint child = 0; child < _to_examine.children.size();
+  for (uint child = 0; child < examined_children.size();
        ++child) {
-    if (!is_of_form(_to_examine.children.at(child),
-                    _form.children.at(child), _free_variables,
+    if (!is_of_form(examined_children[child],
+                    form_children[child], _free_variables,
                     _substitutions)) {
       return false;
     }
@@ -87,26 +94,176 @@ bool InferenceMaker::is_of_form(
   return true;
 }
 
-int InferenceMaker::has(const ASTNode &_what) const noexcept {
-  for (int i = known.size() - 1; i >= 0; --i) {
-    if (known.at(i).thm == _what) {
-      return i;
+bool InferenceMaker::is_of_form(
+    const ASTNode &_to_examine, const ASTNode &_form,
+    std::set<ASTNode> &_free_variables,
+    std::list<std::pair<ASTNode, ASTNode>> &_substitutions) {
+  std::set<SymbolId> fv;
+  for (const auto &item : _free_variables) {
+    fv.insert(symbols.intern(item.text.text));
+  }
+  std::list<std::pair<TermId, TermId>> subs;
+  for (const auto &p : _substitutions) {
+    subs.push_back({term_store.intern(p.first),
+                    term_store.intern(p.second)});
+  }
+
+  const bool out =
+      is_of_form(term_store.intern(_to_examine),
+                 term_store.intern(_form), fv, subs);
+
+  // Translate the results back
+  for (auto it = _free_variables.begin();
+       it != _free_variables.end();) {
+    if (fv.contains(symbols.intern(it->text.text))) {
+      ++it;
+    } else {
+      it = _free_variables.erase(it);
+    }
+  }
+  _substitutions.clear();
+  for (const auto &p : subs) {
+    _substitutions.push_back({term_store.to_ast(p.first),
+                              term_store.to_ast(p.second)});
+  }
+  return out;
+}
+
+thread_local InferenceMaker::SearchPath InferenceMaker::path;
+
+/// Returns the resident memory of this process in bytes, or 0
+/// if it cannot be measured
+static size_t resident_memory() {
+  std::ifstream statm("/proc/self/statm");
+  size_t total = 0, resident = 0;
+  if (!(statm >> total >> resident)) {
+    return 0;
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+void InferenceMaker::start_limits() noexcept {
+  limits_started = std::chrono::steady_clock::now();
+  limits_theorems = epoch().first;
+  limits_nodes = 0;
+  limits_checks = 0;
+  limit_hit = NO_LIMIT;
+}
+
+InferenceMaker::Limit InferenceMaker::over_limit(
+    const size_t &_pending,
+    const size_t &_growing) const noexcept {
+  Limit out = limit_hit;
+  if (out != NO_LIMIT) {
+    return out;
+  }
+
+  // Reading the memory use is slow, so it is only checked on
+  // some calls
+  if (limits.time.count() > 0 &&
+      std::chrono::steady_clock::now() - limits_started >=
+          limits.time) {
+    out = TIME_LIMIT;
+  } else if (limits.theorems > 0 &&
+             epoch().first - limits_theorems + _pending >=
+                 limits.theorems) {
+    out = THEOREM_LIMIT;
+  } else if (limits.nodes > 0 &&
+             limits_nodes > limits.nodes) {
+    out = NODE_LIMIT;
+  } else if (limits.memory > 0 &&
+             (_growing > 0 || limits_checks++ % 1024 == 0) &&
+             resident_memory() + _growing >= limits.memory) {
+    out = MEMORY_LIMIT;
+  }
+
+  if (out != NO_LIMIT) {
+    Limit expected = NO_LIMIT;
+    limit_hit.compare_exchange_strong(expected, out);
+    if (debug) {
+      std::cout << "Hit resource limit " << (int)out << "\n";
     }
   }
-  return -1;
+  return limit_hit;
+}
+
+InferenceMaker::Limit InferenceMaker::count_node() noexcept {
+  ++limits_nodes;
+  return over_limit();
+}
+
+int InferenceMaker::has(const TermId &_what) const noexcept {
+  std::shared_lock lock(known_mutex);
+  const auto it = known_index.find(_what);
+  if (it == known_index.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+InferenceMaker::Epoch InferenceMaker::epoch() const noexcept {
+  std::shared_lock lock(known_mutex);
+  return {known.size(), rules.size()};
+}
+
+bool InferenceMaker::known_failure(const TermId &_what,
+                                   const int &_passes) {
+  std::lock_guard lock(failed_goals_mutex);
+
+  // A new theorem or rule may make any failed goal provable
+  if (failed_goals_epoch != epoch()) {
+    failed_goals.clear();
+    failed_goals_epoch = epoch();
+    return false;
+  }
+
+  // Failure with some passes implies failure with fewer
+  const auto it = failed_goals.find(_what);
+  return it != failed_goals.end() && it->second >= _passes;
+}
+
+void InferenceMaker::record_failure(const TermId &_what,
+                                    const int &_passes,
+                                    const Epoch &_started) {
+  // If a subgoal was proven along the way, branches explored
+  // before then might now go differently
+  std::lock_guard lock(failed_goals_mutex);
+  if (_started != epoch()) {
+    return;
+  }
+  if (failed_goals_epoch != _started) {
+    failed_goals.clear();
+    failed_goals_epoch = _started;
+  }
+  auto [it, added] = failed_goals.insert({_what, _passes});
+  if (!added) {
+    it->second = std::max(it->second, _passes);
+  }
 }
 
 size_t
-InferenceMaker::add_axiom(const ASTNode &_what) noexcept {
+InferenceMaker::add_axiom(const TermId &_what) noexcept {
+  std::unique_lock lock(known_mutex);
+  known_index[_what] = known.size();
+  known_terms_index.insert(_what, {}, known.size());
   known.push_back({known.size(), _what, -1, {}});
   if (debug) {
-    std::cout << "Added axiom: " << _what << "\n\n";
+    std::cout << "Added axiom: ";
+    term_store.print(std::cout, _what);
+    std::cout << "\n\n";
   }
   return known.back().index;
 }
 
 void InferenceMaker::add_rule(const InferenceRule &_rule) {
   rules.push_back(_rule);
+  rules.back().compile();
+  rule_watermarks.push_back(0);
+  if (_rule.type != InferenceRule::FORWARD_ONLY) {
+    consequence_index.insert(_rule.consequence,
+                             _rule.free_variables,
+                             rules.size() - 1);
+  }
   if (debug) {
     std::cout << "Added rule w/ index " << rules.size() - 1
               << ": " << _rule << "\n\n";
@@ -116,17 +273,39 @@ void InferenceMaker::add_rule(const InferenceRule &_rule) {
 InferenceMaker::InferenceRule::InferenceRule(
     const std::set<ASTNode> &_fv,
     const std::list<ASTNode> &_req, const ASTNode &_cons)
+    : InferenceRule(
+          [&]() {
+            std::set<SymbolId> out;
+            for (const auto &fv : _fv) {
+              out.insert(symbols.intern(fv.text.text));
+            }
+            return out;
+          }(),
+          [&]() {
+            std::vector<TermId> out;
+            for (const auto &req : _req) {
+              out.push_back(term_store.intern(req));
+            }
+            return out;
+          }(),
+          term_store.intern(_cons)) {
+}
+
+InferenceMaker::InferenceRule::InferenceRule(
+    const std::set<SymbolId> &_fv,
+    const std::vector<TermId> &_req, const TermId &_cons)
     : free_variables(_fv), requirements(_req),
       consequence(_cons) {
   bool has_fvs_in_cons = true;
   bool has_fvs_in_reqs = true;
-  for (const auto &fv : free_variables) {
-    if (has_fvs_in_cons && !consequence.contains(fv)) {
+  for (const auto &fv : free_variables_by_name()) {
+    if (has_fvs_in_cons &&
+        !term_store.contains_symbol(consequence, fv)) {
       has_fvs_in_cons = false;
     } else if (has_fvs_in_reqs) {
       bool has_a_req_w_var = false;
       for (const auto &rule : requirements) {
-        if (rule.contains(fv)) {
+        if (term_store.contains_symbol(rule, fv)) {
           has_a_req_w_var = true;
           break;
         }
@@ -140,7 +319,8 @@ InferenceMaker::InferenceRule::InferenceRule(
   }
 
   // Replace is whack
-  if (consequence.contains("REPLACE")) {
+  if (term_store.contains_symbol(consequence,
+                                 symbols.intern("REPLACE"))) {
     has_fvs_in_cons = false;
   }
 
@@ -165,11 +345,103 @@ InferenceMaker::InferenceRule::InferenceRule(
   }
 }
 
+void InferenceMaker::InferenceRule::compile() {
+  // Number each distinct free variable subterm, in the order
+  // they are first seen
+  slots.clear();
+  const std::function<void(const TermId &)> number =
+      [&](const TermId &_t) {
+        if (free_variables.contains(term_store.head(_t))) {
+          if (std::find(slots.begin(), slots.end(), _t) ==
+              slots.end()) {
+            slots.push_back(_t);
+          }
+          return;
+        }
+        for (const auto &child : term_store.children(_t)) {
+          number(child);
+        }
+      };
+  number(consequence);
+  for (const auto &req : requirements) {
+    number(req);
+  }
+  if (slots.size() > max_free_variables) {
+    throw std::runtime_error(
+        "Rules may have at most " +
+        std::to_string(max_free_variables) +
+        " free variables");
+  }
+
+  // Replace them with numbered variables
+  std::list<std::pair<TermId, TermId>> to_schema;
+  variables.clear();
+  for (uint i = 0; i < slots.size(); ++i) {
+    variables.push_back(term_store.make(symbols.variable(i)));
+    to_schema.push_back({slots[i], variables[i]});
+  }
+  consequence_schema =
+      term_store.replace(consequence, to_schema);
+  requirement_schemas.clear();
+  for (const auto &req : requirements) {
+    requirement_schemas.push_back(
+        term_store.replace(req, to_schema));
+  }
+
+  // Compile the schemas
+  consequence_program =
+      MatchProgram::compile(consequence_schema);
+  requirement_programs.clear();
+  for (const auto &schema : requirement_schemas) {
+    requirement_programs.push_back(
+        MatchProgram::compile(schema));
+  }
+}
+
+void InferenceMaker::InferenceRule::fill_unbound(
+    Bindings &_bindings) const noexcept {
+  for (uint i = 0; i < slots.size(); ++i) {
+    if (_bindings[i] == unbound) {
+      _bindings[i] = slots[i];
+    }
+  }
+}
+
+TermId InferenceMaker::InferenceRule::partially_instantiate(
+    const TermId &_schema, const Bindings &_bindings) const {
+  Bindings partial = _bindings;
+  for (uint i = 0; i < slots.size(); ++i) {
+    if (partial[i] == unbound) {
+      partial[i] = variables[i];
+    }
+  }
+  return term_store.instantiate(_schema, partial);
+}
+
+std::vector<SymbolId>
+InferenceMaker::InferenceRule::free_variables_by_name() const {
+  std::vector<SymbolId> out(free_variables.begin(),
+                            free_variables.end());
+  std::sort(out.begin(), out.end(),
+            [](const SymbolId &_lhs, const SymbolId &_rhs) {
+              return symbols.text(_lhs) < symbols.text(_rhs);
+            });
+  return out;
+}
+
 std::optional<InferenceMaker::Theorem>
-InferenceMaker::backward_prove(const ASTNode &_what,
+InferenceMaker::backward_prove(const TermId &_what,
                                const int &_passes) {
   if (debug) {
-    std::cout << "WTS " << _what << "\n";
+    std::cout << "WTS ";
+    term_store.print(std::cout, _what);
+    std::cout << "\n";
+  }
+
+  // If some parallel sibling has already succeeded
+  if (path.cancellation != nullptr &&
+      path.cancellation->cancelled()) {
+    return {};
   }
 
   // If we have already proven this, return that proof
@@ -178,31 +450,406 @@ InferenceMaker::backward_prove(const ASTNode &_what,
     return get_theorem(res);
   }
 
-  // If we're out of passes
+  // If we're out of passes, steps or resources
+  if (_passes <= 0 || path.steps_left == 0 ||
+      count_node() != NO_LIMIT) {
+    return {};
+  }
+  --path.steps_left;
+
+  // If this has failed before with at least as many passes and
+  // nothing has been learned since, it will fail again
+  if (known_failure(_what, _passes)) {
+    if (debug) {
+      std::cout << "Known failure\n";
+    }
+    return {};
+  }
+
+  // Any proof which revisits a goal on the current path
+  // contains a shorter proof of it, so such branches can go
+  const auto ancestor = path.goal_depths.find(_what);
+  if (ancestor != path.goal_depths.end()) {
+    if (debug) {
+      std::cout << "Cycle\n";
+    }
+    path.lowest_pruned_depth =
+        std::min(path.lowest_pruned_depth, ancestor->second);
+    return {};
+  }
+
+  const Epoch started = epoch();
+  const size_t depth = path.goal_depths.size();
+  const size_t outer_pruned_depth = path.lowest_pruned_depth;
+  path.lowest_pruned_depth = no_pruned_depth;
+  path.goal_depths.insert({_what, depth});
+
+  const auto out = backward_step(_what, _passes);
+  path.goal_depths.erase(_what);
+
+  // A failure which relied on pruning a goal further up the
+  // path may not be a failure elsewhere, and neither may one
+  // which was cut short
+  const bool cut_short = path.steps_left == 0 ||
+                         (path.cancellation != nullptr &&
+                          path.cancellation->cancelled()) ||
+                         over_limit() != NO_LIMIT;
+  if (!out.has_value() && !cut_short) {
+    if (path.lowest_pruned_depth >= depth) {
+      record_failure(_what, _passes, started);
+    }
+    if (path.stuck != nullptr) {
+      path.stuck->insert(_what);
+    }
+  }
+  path.lowest_pruned_depth =
+      std::min(outer_pruned_depth, path.lowest_pruned_depth);
+
+  return out;
+}
+
+WorkStealingPool &InferenceMaker::get_pool() {
+  if (!pool || pool->size() != threads) {
+    pool = std::make_unique<WorkStealingPool>(threads);
+  }
+  return *pool;
+}
+
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::parallel_prove(const TermId &_what,
+                               const int &_passes) {
+  get_pool();
+  return parallel_step(_what, _passes, 0, nullptr);
+}
+
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::parallel_step(
+    const TermId &_what, const int &_passes, const int &_depth,
+    const Cancellation *_cancellation) {
+  if ((_cancellation != nullptr &&
+       _cancellation->cancelled()) ||
+      count_node() != NO_LIMIT) {
+    return {};
+  }
+
+  // Deep enough that there is plenty of work to go around
+  if (_depth >= spawn_depth) {
+    const SearchPath outer = path;
+    path = {.cancellation = _cancellation};
+    const auto out = backward_prove(_what, _passes);
+    path = outer;
+    return out;
+  }
+
+  const int res = has(_what);
+  if (res >= 0) {
+    return get_theorem(res);
+  }
   if (_passes <= 0) {
     return {};
   }
 
-  // Examine each rule
-  for (uint rule_index = 0; rule_index < rules.size();
-       ++rule_index) {
-    const auto rule = rules.at(rule_index);
-    if (rule.type == InferenceRule::FORWARD_ONLY) {
+  // Each matching rule is an independent task
+  struct Group {
+    Cancellation cancellation;
+    std::atomic<size_t> remaining;
+    std::mutex mutex;
+    std::optional<Theorem> result;
+    std::exception_ptr error;
+  } group;
+  group.cancellation.parent = _cancellation;
+
+  std::vector<std::pair<uint, std::vector<TermId>>>
+      applications;
+  for (const auto &rule_index :
+       consequence_index.retrieve_generalizations(_what)) {
+    const auto &rule = rules.at(rule_index);
+    Bindings bindings = no_bindings();
+    if (rule.consequence_program.run(_what, bindings)) {
+      rule.fill_unbound(bindings);
+      applications.push_back({(uint)rule_index, {}});
+      for (const auto &schema : rule.requirement_schemas) {
+        applications.back().second.push_back(
+            term_store.instantiate(schema, bindings));
+      }
+    }
+  }
+  group.remaining = applications.size();
+
+  for (const auto &[rule_index, requirements] : applications) {
+    pool->submit([&, rule_index, requirements]() {
+      try {
+        std::list<size_t> premises;
+        const bool rule_works = parallel_requirements(
+            requirements, _passes - 1, _depth + 1,
+            &group.cancellation, premises);
+
+        if (rule_works && !group.cancellation.cancelled()) {
+          bool trash = true;
+          const auto thm =
+              add_theorem(_what, rule_index, premises, trash);
+          std::lock_guard lock(group.mutex);
+          if (!group.result.has_value()) {
+            group.result.emplace(thm);
+          }
+          group.cancellation.cancel();
+        }
+      } catch (...) {
+        std::lock_guard lock(group.mutex);
+        group.error = std::current_exception();
+        group.cancellation.cancel();
+      }
+
+      // The group may be gone as soon as this hits zero
+      --group.remaining;
+    });
+  }
+
+  pool->help_until([&]() { return group.remaining == 0; });
+  if (group.error) {
+    std::rethrow_exception(group.error);
+  }
+  return group.result;
+}
+
+bool InferenceMaker::parallel_requirements(
+    const std::vector<TermId> &_requirements,
+    const int &_passes, const int &_depth,
+    const Cancellation *_cancellation,
+    std::list<size_t> &_premises) {
+  if (!and_parallel || _requirements.size() < 2) {
+    for (const auto &requirement : _requirements) {
+      const auto res = parallel_step(requirement, _passes,
+                                     _depth, _cancellation);
+      if (!res.has_value()) {
+        return false;
+      }
+      _premises.push_back(res.value().index);
+    }
+    return true;
+  }
+
+  // Every requirement at once, until one of them fails
+  struct Group {
+    Cancellation cancellation;
+    std::atomic<size_t> remaining;
+    std::vector<size_t> results;
+    std::mutex mutex;
+    std::exception_ptr error;
+  } group;
+  group.cancellation.parent = _cancellation;
+  group.remaining = _requirements.size();
+  group.results.resize(_requirements.size(), SIZE_MAX);
+
+  for (size_t i = 0; i < _requirements.size(); ++i) {
+    pool->submit([&, i]() {
+      try {
+        const auto res =
+            parallel_step(_requirements[i], _passes, _depth,
+                          &group.cancellation);
+        if (res.has_value()) {
+          group.results[i] = res.value().index;
+        } else {
+          group.cancellation.cancel();
+        }
+      } catch (...) {
+        std::lock_guard lock(group.mutex);
+        group.error = std::current_exception();
+        group.cancellation.cancel();
+      }
+
+      // The group may be gone as soon as this hits zero
+      --group.remaining;
+    });
+  }
+
+  pool->help_until([&]() { return group.remaining == 0; });
+  if (group.error) {
+    std::rethrow_exception(group.error);
+  }
+  if (group.cancellation.cancelled()) {
+    return false;
+  }
+  _premises.insert(_premises.end(), group.results.begin(),
+                   group.results.end());
+  return true;
+}
+
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::deepening_prove(const TermId &_what,
+                                const int &_passes) {
+  for (int bound = 0; bound <= _passes; ++bound) {
+    if (debug) {
+      std::cout << "Deepening to " << bound << "\n";
+    }
+    const auto res = backward_prove(_what, bound);
+    if (res.has_value() || over_limit() != NO_LIMIT) {
+      return res;
+    }
+  }
+  return {};
+}
+
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::best_first_prove(const TermId &_what,
+                                 const int &_passes) {
+  // If we have already proven this, return that proof
+  const int res = has(_what);
+  if (res >= 0) {
+    return get_theorem(res);
+  }
+
+  // The frontier holds (priority, order made, slot in states)
+  // so ties go to the earliest state. Slots of states already
+  // expanded are reused.
+  using Entry = std::tuple<size_t, size_t, size_t>;
+  std::vector<SearchStep> steps;
+  std::vector<SearchState> states;
+  std::vector<size_t> free_slots;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>>
+      frontier;
+  size_t n_made = 0;
+
+  states.push_back({{{_what, no_step, _passes}}, no_step, 0});
+  frontier.push({term_store.weight(_what), n_made++, 0});
+
+  while (!frontier.empty() && count_node() == NO_LIMIT) {
+    const size_t slot = std::get<2>(frontier.top());
+    frontier.pop();
+    SearchState state = std::move(states[slot]);
+    free_slots.push_back(slot);
+
+    // Anything proven since this state was made is done
+    while (!state.open.empty() &&
+           has(state.open.back().goal) >= 0) {
+      state.open.pop_back();
+    }
+    if (state.open.empty()) {
+      replay(steps, state.last_step);
+      return get_theorem(has(_what));
+    }
+
+    const SearchGoal goal = state.open.back();
+    state.open.pop_back();
+
+    if (debug) {
+      std::cout << "WTS ";
+      term_store.print(std::cout, goal.goal);
+      std::cout << " at cost " << state.cost << "\n";
+    }
+
+    if (goal.passes <= 0 ||
+        known_failure(goal.goal, goal.passes)) {
+      continue;
+    }
+
+    // As in backward_prove, revisiting a goal on the path to
+    // this one cannot help
+    bool cycle = false;
+    for (uint32_t s = goal.parent; s != no_step && !cycle;
+         s = steps[s].parent) {
+      cycle = steps[s].goal == goal.goal;
+    }
+    if (cycle) {
       continue;
     }
 
+    const auto candidates =
+        consequence_index.retrieve_generalizations(goal.goal);
+    for (const auto &rule_index : candidates) {
+      const auto &rule = rules.at(rule_index);
+      Bindings bindings = no_bindings();
+      if (!rule.consequence_program.run(goal.goal, bindings)) {
+        continue;
+      }
+      rule.fill_unbound(bindings);
+
+      const uint32_t step = steps.size();
+      steps.push_back({goal.goal, (uint)rule_index, {},
+                       goal.parent, state.last_step});
+      for (const auto &schema : rule.requirement_schemas) {
+        steps.back().requirements.push_back(
+            term_store.instantiate(schema, bindings));
+      }
+
+      // The first requirement is expanded first
+      SearchState next = {state.open, step,
+                          state.cost + rule.cost};
+      const auto &requirements = steps.back().requirements;
+      for (auto it = requirements.rbegin();
+           it != requirements.rend(); ++it) {
+        next.open.push_back({*it, step, goal.passes - 1});
+      }
+
+      size_t priority = next.cost;
+      int fewest_passes = _passes;
+      for (const auto &open : next.open) {
+        priority += term_store.weight(open.goal);
+        fewest_passes = std::min(fewest_passes, open.passes);
+      }
+      priority += _passes - fewest_passes;
+
+      if (free_slots.empty()) {
+        free_slots.push_back(states.size());
+        states.emplace_back();
+      }
+      frontier.push({priority, n_made++, free_slots.back()});
+      states[free_slots.back()] = std::move(next);
+      free_slots.pop_back();
+    }
+  }
+
+  // No partial proof could be finished
+  return {};
+}
+
+void InferenceMaker::replay(
+    const std::vector<SearchStep> &_steps,
+    const uint32_t &_last_step) {
+  // Every step in a state came after the step it proves a
+  // requirement of, so going backwards proves premises first
+  for (uint32_t s = _last_step; s != no_step;
+       s = _steps[s].previous) {
+    const auto &step = _steps[s];
+    std::list<size_t> premises;
+    for (const auto &requirement : step.requirements) {
+      // Theorems are stored beta-reduced
+      int index = has(requirement);
+      if (index < 0) {
+        index = has(term_store.beta_star(requirement));
+      }
+      if (index < 0) {
+        throw std::runtime_error(
+            "Best-first proof is missing a premise");
+      }
+      premises.push_back(index);
+    }
+    bool trash = true;
+    add_theorem(step.goal, step.rule_index, premises, trash);
+  }
+}
+
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::backward_step(const TermId &_what,
+                              const int &_passes) {
+  // Examine each rule whose consequence could match
+  for (const auto &rule_index :
+       consequence_index.retrieve_generalizations(_what)) {
+    const auto &rule = rules.at(rule_index);
+
     // If _what is of the form of the implication of the rule
-    auto free_variables = rule.free_variables;
-    std::list<std::pair<ASTNode, ASTNode>> substitutions;
-    if (is_of_form(_what, rule.consequence, free_variables,
-                   substitutions)) {
+    Bindings bindings = no_bindings();
+    if (rule.consequence_program.run(_what, bindings)) {
+      rule.fill_unbound(bindings);
+
       // Now we have to prove that, given these substitutions,
       // ALL of the LHS of the implication are provable
       bool rule_works = true;
       std::list<size_t> premises;
-      for (const auto &to_prove_schema : rule.requirements) {
+      for (const auto &to_prove_schema :
+           rule.requirement_schemas) {
         const auto to_prove =
-            to_prove_schema.replace(substitutions);
+            term_store.instantiate(to_prove_schema, bindings);
 
         const std::optional<Theorem> res =
             backward_prove(to_prove, _passes - 1);
@@ -223,77 +870,338 @@ InferenceMaker::backward_prove(const ASTNode &_what,
   }
 
   // No rule worked
-  if (enable_alternation) {
-    // Alternate to forward_prove (with reduced pass bound)
-    return forward_prove(_what, _passes - 1);
+  return {};
+}
+
+void InferenceMaker::inst_all(const uint &_rule_index,
+                              const uint &_first_n_thms) {
+  const size_t watermark = rule_watermarks[_rule_index];
+  std::vector<ForwardJob> jobs;
+  plan_inst_all(_rule_index, _first_n_thms, jobs);
+
+  std::vector<PendingTheorem> delta;
+  for (const auto &job : jobs) {
+    std::list<size_t> premises;
+    join(job, 0, no_bindings(), premises, delta);
   }
+  commit(delta);
 
-  return {};
+  // If a limit cut this short, redo it all next time
+  if (over_limit() != NO_LIMIT) {
+    rule_watermarks[_rule_index] = watermark;
+  }
 }
 
-void InferenceMaker::inst_all(
+void InferenceMaker::plan_inst_all(
     const uint &_rule_index, const uint &_first_n_thms,
-    const std::vector<uint> &_cur_indices) {
+    std::vector<ForwardJob> &_jobs) {
+  const auto &rule = rules.at(_rule_index);
 
-  static std::set<std::pair<uint, std::vector<uint>>>
-      nontheorem_pairings;
+  // Every tuple drawn entirely from before the watermark has
+  // already been tried, so only tuples with at least one newer
+  // theorem are worth trying (semi-naive evaluation)
+  const size_t old_end = std::min<size_t>(
+      rule_watermarks.at(_rule_index), _first_n_thms);
+  rule_watermarks[_rule_index] = std::max<size_t>(
+      rule_watermarks[_rule_index], _first_n_thms);
 
-  const auto rule = rules.at(_rule_index);
+  auto candidates =
+      std::make_shared<std::vector<std::vector<size_t>>>();
+  if (rule.requirements.empty()) {
+    _jobs.push_back({_rule_index, candidates, {}});
+    return;
+  }
 
-  if (_cur_indices.size() < rule.requirements.size()) {
-    std::vector<uint> to_visit;
-    for (uint i = 0; i < known.size() && i < _first_n_thms;
-         ++i) {
-      std::vector<uint> next_ind = _cur_indices;
-      next_ind.push_back(i);
+  // Only theorems which could match a requirement on their own
+  // are candidates for its slot
+  for (const auto &req : rule.requirements) {
+    candidates->push_back(known_terms_index.retrieve_unifiable(
+        req, rule.free_variables));
+    auto &slot = candidates->back();
+    slot.erase(std::lower_bound(slot.begin(), slot.end(),
+                                _first_n_thms),
+               slot.end());
+    if (slot.empty()) {
+      return;
+    }
+  }
 
-      inst_all(_rule_index, _first_n_thms, next_ind);
+  // Partition the new tuples by their first new slot: Earlier
+  // slots are old, that slot is new, and later slots are
+  // anything
+  for (uint new_slot = 0; new_slot < candidates->size();
+       ++new_slot) {
+    std::vector<std::pair<size_t, size_t>> bounds;
+    for (uint i = 0; i < candidates->size(); ++i) {
+      if (i < new_slot) {
+        bounds.push_back({0, old_end});
+      } else if (i == new_slot) {
+        bounds.push_back({old_end, _first_n_thms});
+      } else {
+        bounds.push_back({0, _first_n_thms});
+      }
     }
-  } else {
-    if (nontheorem_pairings.contains(
-            {_rule_index, _cur_indices})) {
+    _jobs.push_back({_rule_index, candidates, bounds});
+  }
+}
+
+size_t InferenceMaker::commit(
+    const std::vector<PendingTheorem> &_delta) {
+  size_t out = 0;
+  for (const auto &pending : _delta) {
+    if (over_limit() != NO_LIMIT) {
+      break;
+    }
+    bool actually_added = true;
+    add_theorem(pending.thm, pending.rule_index,
+                pending.premises, actually_added);
+    out += actually_added;
+  }
+  return out;
+}
+
+void InferenceMaker::update_rete() {
+  if (over_limit() != NO_LIMIT) {
+    return;
+  }
+
+  // Matches not yet added count against the theorem limit
+  std::vector<ReteNetwork::Match> matches;
+  const auto stop = [&]() {
+    return over_limit(rete_agenda.size() + matches.size()) !=
+           NO_LIMIT;
+  };
+  bool whole = true;
+  for (; whole && rete_rules < rules.size(); ++rete_rules) {
+    const auto &rule = rules[rete_rules];
+    if (rule.type != InferenceRule::BACKWARD_ONLY) {
+      whole = rete.add_rule(rete_rules,
+                            rule.requirement_programs, matches,
+                            stop);
+    }
+  }
+  for (size_t i = rete.n_facts(); whole && i < known.size();
+       ++i) {
+    whole = rete.add_fact(i, known[i].thm, matches, stop);
+  }
+
+  for (auto &match : matches) {
+    if (!whole || stop()) {
+      whole = false;
+      break;
+    }
+    const auto &rule = rules[match.rule];
+    rule.fill_unbound(match.bindings);
+    rete_agenda.push_back(
+        {term_store.instantiate(rule.consequence_schema,
+                                match.bindings),
+         match.rule,
+         {match.premises.begin(), match.premises.end()}});
+  }
+
+  // The network never makes a match twice, so any it was cut
+  // short before making are lost. Rebuilding it makes them all
+  // again, and add_theorem ignores those already known.
+  if (!whole) {
+    rete = ReteNetwork();
+    rete_rules = 0;
+    rete_agenda.clear();
+  }
+}
+
+size_t
+InferenceMaker::parallel_pass(const uint &_first_n_thms) {
+  const auto watermarks = rule_watermarks;
+  std::vector<ForwardJob> jobs;
+  for (uint rule_index = 0; rule_index < rules.size();
+       ++rule_index) {
+    if (rules[rule_index].type !=
+        InferenceRule::BACKWARD_ONLY) {
+      plan_inst_all(rule_index, _first_n_thms, jobs);
+    }
+  }
+
+  // Shard each job on its first slot, so that one busy rule
+  // can still keep every thread occupied
+  std::vector<ForwardJob> shards;
+  for (const auto &job : jobs) {
+    if (job.bounds.empty()) {
+      shards.push_back(job);
+      continue;
+    }
+    const auto &first = job.candidates->front();
+    const auto [lo, hi] = job.bounds.front();
+    const auto begin =
+        std::lower_bound(first.begin(), first.end(), lo);
+    const auto end = std::lower_bound(begin, first.end(), hi);
+    const size_t n = end - begin;
+    const size_t n_shards = std::max<size_t>(
+        1, std::min<size_t>(n, threads));
+    for (size_t i = 0; i < n_shards; ++i) {
+      ForwardJob shard = job;
+      const auto from = begin + n * i / n_shards;
+      const auto to = begin + n * (i + 1) / n_shards;
+      shard.bounds.front() = {from == end ? hi : *from,
+                              to == end ? hi : *to};
+      shards.push_back(shard);
+    }
+  }
+
+  // Each shard fills its own delta, and only reads known
+  std::vector<std::vector<PendingTheorem>> deltas(
+      shards.size());
+  std::atomic<size_t> remaining = shards.size();
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto &workers = get_pool();
+  for (size_t i = 0; i < shards.size(); ++i) {
+    workers.submit([&, i]() {
+      try {
+        std::list<size_t> premises;
+        join(shards[i], 0, no_bindings(), premises, deltas[i]);
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        error = std::current_exception();
+      }
+      --remaining;
+    });
+  }
+  workers.help_until([&]() { return remaining == 0; });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  // Shards are in sequential order, so this is deterministic
+  size_t out = 0;
+  for (const auto &delta : deltas) {
+    out += commit(delta);
+  }
+
+  // If a limit cut this short, redo it all next time
+  if (over_limit() != NO_LIMIT) {
+    rule_watermarks = watermarks;
+  }
+  return out;
+}
+
+void InferenceMaker::join(
+    const ForwardJob &_job, const uint &_slot,
+    const Bindings &_bindings, std::list<size_t> &_premises,
+    std::vector<PendingTheorem> &_delta) const {
+  const auto &rule = rules.at(_job.rule_index);
+  if (over_limit(_delta.size()) != NO_LIMIT) {
+    return;
+  }
+
+  // Every requirement matched: derive the consequence
+  if (_slot == rule.requirements.size()) {
+    // If _delta is full, it is about to double
+    if (_delta.size() == _delta.capacity() &&
+        over_limit(_delta.size(),
+                   _delta.capacity() *
+                       sizeof(PendingTheorem)) != NO_LIMIT) {
       return;
     }
+    Bindings full = _bindings;
+    rule.fill_unbound(full);
+    _delta.push_back(
+        {term_store.instantiate(rule.consequence_schema, full),
+         _job.rule_index, _premises});
+    return;
+  }
+
+  // If earlier slots bound some of this requirement's
+  // variables, ask the index again with them filled in
+  const TermId schema = rule.requirement_schemas[_slot];
+  const TermId narrowed =
+      rule.partially_instantiate(schema, _bindings);
+  std::vector<size_t> retrieved;
+  if (narrowed != schema) {
+    retrieved =
+        known_terms_index.retrieve_unifiable(narrowed, {});
+  }
+  const auto &choices = narrowed != schema
+                            ? retrieved
+                            : (*_job.candidates)[_slot];
+
+  const auto [lo, hi] = _job.bounds[_slot];
+  auto it =
+      std::lower_bound(choices.begin(), choices.end(), lo);
+  for (; it != choices.end() && *it < hi; ++it) {
+    Bindings next = _bindings;
+    if (!rule.requirement_programs[_slot].run(known[*it].thm,
+                                               next)) {
+      continue;
+    }
+    _premises.push_back(*it);
+    join(_job, _slot + 1, next, _premises, _delta);
+    _premises.pop_back();
+  }
+}
 
-    // Determine substitutions, if they exist
-    auto fv = rule.free_variables;
-    std::list<std::pair<ASTNode, ASTNode>> substitutions;
-    uint req_ind = 0;
-    for (const auto &corresponding_requirement :
-         rule.requirements) {
-      const auto thm =
-          get_theorem(_cur_indices.at(req_ind)).thm;
-      if (!is_of_form(
-              thm,
-              corresponding_requirement.replace(substitutions),
-              fv, substitutions)) {
-        nontheorem_pairings.insert({_rule_index, _cur_indices});
-        return;
+size_t
+InferenceMaker::forward_pass(const std::function<bool()> &_done,
+                             const int &_pass,
+                             const int &_passes) {
+  // The network has already matched everything known, so a
+  // pass only adds what it found
+  if (use_rete) {
+    update_rete();
+    std::vector<PendingTheorem> agenda;
+    std::swap(agenda, rete_agenda);
+    const size_t out = commit(agenda);
+
+    // If a limit cut this short, redo it all next time
+    if (over_limit() != NO_LIMIT) {
+      rete_agenda = std::move(agenda);
+    }
+    return out;
+  }
+
+  // With threads to spare, every rule sees the theorems known
+  // at the start of the pass, and they run all at once
+  if (threads > 1) {
+    return parallel_pass(known.size());
+  }
+
+  // For each rule
+  size_t n_instantiated = 0;
+  for (uint rule_index = 0;
+       rule_index < rules.size() && over_limit() == NO_LIMIT;
+       ++rule_index) {
+    const auto &rule = rules.at(rule_index);
+    if (rule.type == InferenceRule::BACKWARD_ONLY) {
+      if (debug) {
+        std::cout << "In forward pass " << _pass << " of "
+                  << _passes << " skipping rule " << rule
+                  << " of total " << rules.size() << "\n";
       }
-      ++req_ind;
+      continue;
     }
 
-    // Add the thing
-    bool actually_added = true;
-    std::list<size_t> premises;
-    for (const auto &item : _cur_indices) {
-      premises.push_back(item);
+    // Attempt to find ONE instantiation
+    if (debug) {
+      std::cout << "In forward pass " << _pass << " of "
+                << _passes << " examining rule " << rule
+                << " of total " << rules.size() << "\n";
     }
 
-    const auto replaced_cons =
-        rule.consequence.replace(substitutions);
-    const auto res =
-        add_theorem(rule.consequence.replace(substitutions),
-                    _rule_index, premises, actually_added);
+    const auto n_known_before = known.size();
+    inst_all(rule_index, n_known_before);
+    if (known.size() != n_known_before) {
+      n_instantiated += (known.size() - n_known_before);
 
-    if (!actually_added) {
-      nontheorem_pairings.insert({_rule_index, _cur_indices});
+      // If the thing is proven, return early
+      if (_done()) {
+        return n_instantiated;
+      }
     }
   }
+  return n_instantiated;
 }
 
 std::optional<InferenceMaker::Theorem>
-InferenceMaker::forward_prove(const ASTNode &_what,
+InferenceMaker::forward_prove(const TermId &_what,
                               const int &_passes) {
   // If we have already proven this, return that proof
   const int res = has(_what);
@@ -302,42 +1210,13 @@ InferenceMaker::forward_prove(const ASTNode &_what,
   }
 
   // For however many passes
+  const auto done = [&]() { return has(_what) >= 0; };
   for (int cur_pass = 0; cur_pass < _passes; ++cur_pass) {
     // Apply all rules
-    uint n_instantiated = 0;
-
-    // For each rule
-    for (uint rule_index = 0; rule_index < rules.size();
-         ++rule_index) {
-      const auto rule = rules.at(rule_index);
-      if (rule.type == InferenceRule::BACKWARD_ONLY) {
-        if (debug) {
-          std::cout << "In forward pass " << cur_pass << " of "
-                    << _passes << " skipping rule " << rule
-                    << " of total " << rules.size() << "\n";
-        }
-        ++rule_index;
-        continue;
-      }
-
-      // Attempt to find ONE instantiation
-      if (debug) {
-        std::cout << "In forward pass " << cur_pass << " of "
-                  << _passes << " examining rule " << rule
-                  << " of total " << rules.size() << "\n";
-      }
-
-      const auto n_known_before = known.size();
-      inst_all(rule_index, n_known_before);
-      if (known.size() != n_known_before) {
-        n_instantiated += (known.size() - n_known_before);
-
-        // If the thing is proven, return early
-        const auto ind = has(_what);
-        if (ind >= 0) {
-          return get_theorem(ind);
-        }
-      }
+    const size_t n_instantiated =
+        forward_pass(done, cur_pass, _passes);
+    if (done()) {
+      return get_theorem(has(_what));
     }
 
     if (debug) {
@@ -346,36 +1225,92 @@ InferenceMaker::forward_prove(const ASTNode &_what,
     }
 
     // Continuing would be dumb
-    if (n_instantiated == 0) {
+    if (n_instantiated == 0 || over_limit() != NO_LIMIT) {
       break;
     }
   }
 
   // No rule worked
-  if (enable_alternation) {
-    // Alternate to backward_prove (with reduced pass bound)
-    return backward_prove(_what, _passes - 1);
-  }
+  return {};
+}
 
+std::optional<InferenceMaker::Theorem>
+InferenceMaker::alternate_prove(const TermId &_what,
+                                const int &_rounds,
+                                const int &_passes,
+                                const bool &_forward_first) {
+  // The goals backward search could not prove. Once forward
+  // search proves any of them, backward search may get further.
+  std::unordered_set<TermId> stuck = {_what};
+  const auto done = [&]() {
+    for (const auto &goal : stuck) {
+      if (has(goal) >= 0) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (int round = 0; round < _rounds; ++round) {
+    if (round > 0 || !_forward_first) {
+      // Backward, for at most backward_budget goals
+      if (debug) {
+        std::cout << "Round " << round << ": backward\n";
+      }
+      const SearchPath outer = path;
+      path = {.steps_left = backward_budget, .stuck = &stuck};
+      const auto res = backward_prove(_what, _passes);
+      path = outer;
+      if (res.has_value()) {
+        return res;
+      }
+    }
+
+    // Forward, for at most forward_budget passes, or until it
+    // unsticks a goal
+    if (debug) {
+      std::cout << "Round " << round << ": forward\n";
+    }
+    size_t n_instantiated = 0;
+    for (int pass = 0; pass < forward_budget; ++pass) {
+      const size_t n = forward_pass(done, pass, forward_budget);
+      n_instantiated += n;
+      if (n == 0 || done()) {
+        break;
+      }
+    }
+    if (has(_what) >= 0) {
+      return get_theorem(has(_what));
+    }
+
+    // Nothing new would come of another round
+    if (n_instantiated == 0 || over_limit() != NO_LIMIT) {
+      break;
+    }
+  }
   return {};
 }
 
 const InferenceMaker::Theorem InferenceMaker::add_theorem(
-    const ASTNode &_thm, const uint &_rule_index,
+    const TermId &_thm, const uint &_rule_index,
     const std::list<size_t> &_premises, bool &_actually_added) {
-  const auto beta_reduced_thm = _thm.beta_star();
+  const auto beta_reduced_thm = term_store.beta_star(_thm);
 
-  const auto res = has(beta_reduced_thm);
-  if (res >= 0) {
+  std::unique_lock lock(known_mutex);
+  const auto it = known_index.find(beta_reduced_thm);
+  if (it != known_index.end()) {
     _actually_added = false;
-    return get_theorem(res);
+    return known[it->second];
   }
 
   const Theorem out = {.index = known.size(),
                        .thm = beta_reduced_thm,
                        .rule_index = _rule_index,
                        .premises = _premises};
+  known_index[beta_reduced_thm] = out.index;
+  known_terms_index.insert(beta_reduced_thm, {}, out.index);
   known.push_back(out);
+  lock.unlock();
 
   if (debug) {
     std::cout << "Derived theorem " << out << "\n\n";
@@ -401,13 +1336,13 @@ operator<<(std::ostream &_strm,
   }
   _strm << "]<";
   bool first = true;
-  for (const auto &fv : _rule.free_variables) {
+  for (const auto &fv : _rule.free_variables_by_name()) {
     if (first) {
       first = false;
     } else {
       _strm << ", ";
     }
-    _strm << fv;
+    _strm << symbols.text(fv);
   }
   _strm << ">(";
 
@@ -418,21 +1353,24 @@ operator<<(std::ostream &_strm,
     } else {
       _strm << ", ";
     }
-    _strm << p;
+    term_store.print(_strm, p);
   }
-  _strm << ") -> " << _rule.consequence;
+  _strm << ") -> ";
+  term_store.print(_strm, _rule.consequence);
   return _strm;
 }
 
 std::ostream &operator<<(std::ostream &_strm,
                          const InferenceMaker::Theorem &_thm) {
   if (_thm.rule_index < 0) {
-    _strm << "axiom: " << _thm.thm;
+    _strm << "axiom: ";
+    term_store.print(_strm, _thm.thm);
     return _strm;
   }
 
-  _strm << "thm " << _thm.index << ": " << _thm.thm
-        << " due to rule " << _thm.rule_index
+  _strm << "thm " << _thm.index << ": ";
+  term_store.print(_strm, _thm.thm);
+  _strm << " due to rule " << _thm.rule_index
         << " on premises (";
   bool first = true;
   for (const auto &premise : _thm.premises) {
@@ -5,9 +5,22 @@
 #pragma once
 
 #include "../src/parse.hpp"
+#include "index.hpp"
+#include "match.hpp"
+#include "rete.hpp"
+#include "term.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 /// A maker of inferences. It takes rules and axioms and deduces
 /// theorems
@@ -16,10 +29,61 @@ public:
   /// If true, prints some extra info
   bool debug = false;
 
-  /// If true, forward_prove and backward_prove can call each
-  /// other.
+  /// If true, theorems are proven by alternate_prove
   bool enable_alternation = false;
 
+  /// The most goals each backward round of alternate_prove may
+  /// examine
+  size_t backward_budget = 100000;
+
+  /// The most passes each forward round of alternate_prove may
+  /// make
+  int forward_budget = 1;
+
+  /// Hard limits on the cost of proving. Zero means unlimited.
+  struct Limits {
+    /// Wall-clock time
+    std::chrono::milliseconds time{0};
+
+    /// Theorems derived
+    size_t theorems = 0;
+
+    /// Goals examined by backward search. Forward search
+    /// examines no goals, so this does not bound it.
+    size_t nodes = 0;
+
+    /// Resident memory, in bytes
+    size_t memory = 0;
+  };
+
+  /// The limits in force since start_limits was last called
+  Limits limits;
+
+  /// Which limit stopped proving, if any
+  enum Limit : uint8_t {
+    NO_LIMIT,
+    TIME_LIMIT,
+    THEOREM_LIMIT,
+    NODE_LIMIT,
+    MEMORY_LIMIT,
+  };
+
+  /// Starts counting against limits from now
+  void start_limits() noexcept;
+
+  /// Returns the limit which has been exceeded since
+  /// start_limits, or NO_LIMIT. Once a limit is exceeded, every
+  /// prover gives up (without recording failures) until
+  /// start_limits is called again. _pending theorems derived
+  /// but not yet added count against the theorem limit. If
+  /// _growing bytes are about to be allocated, memory is
+  /// measured now and they count against the memory limit.
+  Limit over_limit(const size_t &_pending = 0,
+                   const size_t &_growing = 0) const noexcept;
+
+  /// Counts one goal examined, then returns over_limit
+  Limit count_node() noexcept;
+
   /// If all the requirements are met, the consequences are
   /// implied
   struct InferenceRule {
@@ -31,16 +95,25 @@ public:
                   const std::list<ASTNode> &_req,
                   const ASTNode &_cons);
 
+    /// Construct an inference rule from already-interned parts
+    InferenceRule(const std::set<SymbolId> &_fv,
+                  const std::vector<TermId> &_req,
+                  const TermId &_cons);
+
     /// The free variables over both the requirements and the
-    /// consequence
-    std::set<ASTNode> free_variables;
+    /// consequence. A subterm is a free variable iff its head
+    /// symbol is in this set.
+    std::set<SymbolId> free_variables;
+
+    /// The free variables, ordered by their texts
+    std::vector<SymbolId> free_variables_by_name() const;
 
     /// The things which must be known theorems
-    std::list<ASTNode> requirements;
+    std::vector<TermId> requirements;
 
     /// Given the requirements over some substitutions, derive
     /// this theorem
-    ASTNode consequence;
+    TermId consequence;
 
     /// This is a measure of where the free variables occur. If
     /// a rule is neither, it is an error.
@@ -53,10 +126,50 @@ public:
     /// The type of this rule
     Type type = BACKWARD_ONLY;
 
+    /// What best_first_prove charges for each use of this
+    /// rule. Set by a trailing "cost N" in the rule statement.
+    size_t cost = 1;
+
     /// Substitute the given node for the first requirement and
     /// return the result
     std::optional<InferenceRule>
-    remove_first_req(const ASTNode &_sub) const noexcept;
+    remove_first_req(const TermId &_sub) const noexcept;
+
+    /// The free variable subterms, indexed by variable number.
+    /// Filled by compile.
+    std::vector<TermId> slots;
+
+    /// The numbered variable terms standing for slots. Filled
+    /// by compile.
+    std::vector<TermId> variables;
+
+    /// The consequence, with each free variable subterm
+    /// replaced by its numbered variable symbol. Filled by
+    /// compile.
+    TermId consequence_schema;
+
+    /// The requirements, likewise. Filled by compile.
+    std::vector<TermId> requirement_schemas;
+
+    /// Matches the consequence. Filled by compile.
+    MatchProgram consequence_program;
+
+    /// Matches each requirement. Filled by compile.
+    std::vector<MatchProgram> requirement_programs;
+
+    /// Numbers the free variables and compiles the consequence
+    /// and requirements into match programs sharing one set of
+    /// bindings
+    void compile();
+
+    /// Binds any still-unbound variable to the subterm it
+    /// stands for, so that instantiation leaves it as written
+    void fill_unbound(Bindings &_bindings) const noexcept;
+
+    /// Returns _schema with only the bound variables replaced
+    TermId
+    partially_instantiate(const TermId &_schema,
+                          const Bindings &_bindings) const;
   };
 
   /// A statement, along with proof that it is a theorem
@@ -65,7 +178,7 @@ public:
     const size_t index;
 
     /// The syntactic representation of this theorem
-    const ASTNode thm;
+    const TermId thm;
 
     /// Either the index of the rule causing this theorem or
     /// a negative number (indicating an axiom).
@@ -80,6 +193,12 @@ public:
   /// with
   /// free variables _free_variables (whose substitutions
   /// are logged in _substitutions).
+  static bool is_of_form(
+      const TermId &_to_examine, const TermId &_form,
+      std::set<SymbolId> &_free_variables,
+      std::list<std::pair<TermId, TermId>> &_substitutions);
+
+  /// Equivalent to the above, but over uninterned ASTs
   static bool is_of_form(
       const ASTNode &_to_examine, const ASTNode &_form,
       std::set<ASTNode> &_free_variables,
@@ -91,25 +210,143 @@ public:
   /// Returns nonnegative iff _what has ALREADY been derived.
   /// Return value is -1 for underived, else index of proven
   /// theorem.
-  int has(const ASTNode &_what) const noexcept;
+  int has(const TermId &_what) const noexcept;
 
   /// Attempt to prove the given statement backwards (EG from
   /// implication to implicate-ee). This is NOT necessarily a
   /// decision procedure! Will halt after depth reaches _passes.
-  std::optional<Theorem> backward_prove(const ASTNode &_what,
+  std::optional<Theorem> backward_prove(const TermId &_what,
+                                        const int &_passes);
+
+  /// Equivalent to backward_prove, but the rules matching each
+  /// goal are tried in parallel on the pool, and the first to
+  /// succeed cancels the rest. This never alternates; that is
+  /// left to alternate_prove.
+  std::optional<Theorem> parallel_prove(const TermId &_what,
                                         const int &_passes);
 
+  /// A single goal of parallel_prove, _depth levels below the
+  /// top, which gives up once _cancellation is cancelled
+  std::optional<Theorem>
+  parallel_step(const TermId &_what, const int &_passes,
+                const int &_depth,
+                const Cancellation *_cancellation);
+
+  /// Proves each of _requirements by parallel_step, appending
+  /// their theorem indices to _premises. If and_parallel is
+  /// set, they are proven at once and the first to fail
+  /// cancels the rest. Returns true iff all were proven.
+  bool parallel_requirements(
+      const std::vector<TermId> &_requirements,
+      const int &_passes, const int &_depth,
+      const Cancellation *_cancellation,
+      std::list<size_t> &_premises);
+
+  /// Calls backward_prove with pass bounds 0, 1, ..., _passes
+  /// until one succeeds, so that shallow proofs are found
+  /// before deep ones. Each iteration reuses the theorems
+  /// proven and the failures tabled by the shallower ones.
+  std::optional<Theorem> deepening_prove(const TermId &_what,
+                                         const int &_passes);
+
+  /// A single rule application made by best_first_prove
+  struct SearchStep {
+    /// The goal the rule was applied to
+    TermId goal;
+
+    /// The rule applied
+    uint rule_index;
+
+    /// The goals the rule left to prove
+    std::vector<TermId> requirements;
+
+    /// The step which introduced goal, or no_step
+    uint32_t parent;
+
+    /// The step made just before this one in the same state,
+    /// or no_step
+    uint32_t previous;
+  };
+
+  /// The index of no search step
+  constexpr static uint32_t no_step = UINT32_MAX;
+
+  /// A goal left open in a best_first_prove state
+  struct SearchGoal {
+    /// What must be proven
+    TermId goal;
+
+    /// The step which introduced it, or no_step
+    uint32_t parent;
+
+    /// The passes left below it
+    int passes;
+  };
+
+  /// A partial proof in best_first_prove
+  struct SearchState {
+    /// The goals left to prove. The last is expanded next.
+    std::vector<SearchGoal> open;
+
+    /// The latest step made, or no_step
+    uint32_t last_step;
+
+    /// The total cost of the rules used so far
+    size_t cost;
+  };
+
+  /// Attempt to prove the given statement backwards, but by
+  /// always expanding the cheapest partial proof rather than
+  /// the first one found. A partial proof costs the cost of the
+  /// rules it used, plus the weights of the goals it has left,
+  /// plus the depth of its deepest goal. Goals more than
+  /// _passes rules deep are not expanded. Partial proofs are
+  /// freed once expanded, but every rule application made is
+  /// kept until the search ends, since the partial proofs made
+  /// from it refer to it.
+  std::optional<Theorem> best_first_prove(const TermId &_what,
+                                          const int &_passes);
+
+  /// Adds the theorems proven by the steps leading up to
+  /// _last_step, premises first
+  void replay(const std::vector<SearchStep> &_steps,
+              const uint32_t &_last_step);
+
+  /// Tries once to prove _what by each rule whose consequence
+  /// matches it, proving their requirements by backward_prove
+  std::optional<Theorem> backward_step(const TermId &_what,
+                                       const int &_passes);
+
   /// Attempt to prove the given statement forwards (EG from
   /// requirements to implication). This is NOT necessarily a
   /// decision procedure! Will try each forward-derivable rule
   /// in a round-robin manner until either _what is proven or
   /// _passes applications of each rule have occurred. There is
   /// no direction here!
-  std::optional<Theorem> forward_prove(const ASTNode &_what,
+  std::optional<Theorem> forward_prove(const TermId &_what,
                                        const int &_passes);
 
+  /// Makes one forward pass over every forward rule, stopping
+  /// early once _done returns true, and returns how many new
+  /// theorems were added. _pass of _passes is for debugging.
+  size_t forward_pass(const std::function<bool()> &_done,
+                      const int &_pass, const int &_passes);
+
+  /// Attempt to prove _what by rounds of backward and forward
+  /// search over the same theorems. Each round first searches
+  /// backward, examining at most backward_budget goals, then
+  /// makes at most forward_budget forward passes (stopping
+  /// early if one proves a goal backward search was stuck on).
+  /// Gives up after _rounds rounds, or once a forward slice
+  /// finds nothing new. Backward search goes at most _passes
+  /// rules deep, as in backward_prove. If _forward_first, the
+  /// first round does not search backward.
+  std::optional<Theorem> alternate_prove(
+      const TermId &_what, const int &_rounds,
+      const int &_passes, const bool &_forward_first);
+
   /// Adds an axiom and returns its index
-  size_t add_axiom(const ASTNode &_what) noexcept;
+  size_t add_axiom(const TermId &_what) noexcept;
 
   /// Gets a rule
   const InferenceRule get_rule(const uint &_index) const;
@@ -118,23 +355,212 @@ public:
   const Theorem get_theorem(const uint &_index) const;
 
   /// Adds a theorem
-  const Theorem add_theorem(const ASTNode &_thm,
+  const Theorem add_theorem(const TermId &_thm,
                             const uint &_rule_index,
                             const std::list<size_t> &_premises,
                             bool &_actually_added);
 
   /// Iterates through all possible theorem choices and
   /// instantiates wherever possible. Note that this only looks
-  /// at theorems from the first n of them.
+  /// at theorems from the first n of them, and only at choices
+  /// involving at least one theorem which this rule has not
+  /// seen before.
   void inst_all(const uint &_rule_index,
-                const uint &_first_n_thms,
-                const std::vector<uint> &_cur_indices = {});
+                const uint &_first_n_thms);
+
+  /// A theorem derived by forward instantiation, but not yet
+  /// added
+  struct PendingTheorem {
+    /// The theorem, not yet beta-reduced
+    TermId thm;
+
+    /// The rule which derived it
+    uint rule_index;
+
+    /// The indices of the theorems which satisfied the rule
+    std::list<size_t> premises;
+  };
+
+  /// A share of the tuples inst_all would try, which can be
+  /// joined independently of every other
+  struct ForwardJob {
+    /// The rule to instantiate
+    uint rule_index;
+
+    /// For each requirement, the theorems which could match it
+    std::shared_ptr<const std::vector<std::vector<size_t>>>
+        candidates;
+
+    /// For each requirement, the range of theorem indices to
+    /// try for it
+    std::vector<std::pair<size_t, size_t>> bounds;
+  };
+
+  /// Splits the tuples inst_all would try into jobs, appending
+  /// them to _jobs, and advances the rule's watermark
+  void plan_inst_all(const uint &_rule_index,
+                     const uint &_first_n_thms,
+                     std::vector<ForwardJob> &_jobs);
+
+  /// Adds every pending theorem, in order, and returns how many
+  /// were new
+  size_t commit(const std::vector<PendingTheorem> &_delta);
+
+  /// Runs one pass of every forward-derivable rule over the
+  /// first _first_n_thms theorems on the pool, then adds what
+  /// they found in the same order as a sequential pass over
+  /// those theorems would. Returns the number of new theorems.
+  size_t parallel_pass(const uint &_first_n_thms);
+
+  /// If true, forward_prove finds instantiations with rete
+  /// instead of re-joining every rule on each pass
+  bool use_rete = false;
+
+  /// Matches the requirements of every forward-derivable rule
+  /// against the theorems, as they are added
+  ReteNetwork rete;
+
+  /// The rules with indices below this have been given to rete
+  size_t rete_rules = 0;
+
+  /// Instantiations found by rete but not yet added
+  std::vector<PendingTheorem> rete_agenda;
+
+  /// Gives rete every rule and theorem it has not yet seen,
+  /// appending the instantiations they complete to rete_agenda.
+  /// If a limit cuts this short, rete is discarded (along with
+  /// rete_agenda) and rebuilt on the next call.
+  void update_rete();
+
+  /// Matches requirement _slot (and recursively, the ones after
+  /// it) against the theorems whose indices are within
+  /// _job.bounds[_slot], under the bindings made by earlier
+  /// slots. Whenever every requirement matches, the consequence
+  /// is appended to _delta. This is a nested-loop join which
+  /// abandons a branch as soon as one slot fails. It only reads
+  /// known, so several may run at once. It gives up once a
+  /// limit is hit, counting _delta against the theorem limit.
+  void join(const ForwardJob &_job, const uint &_slot,
+            const Bindings &_bindings,
+            std::list<size_t> &_premises,
+            std::vector<PendingTheorem> &_delta) const;
 
   /// Statements which are known to be true
   std::vector<Theorem> known;
 
+  /// Maps each term in known to its latest index there. Since
+  /// terms are hash-consed, this is a structural hash index.
+  std::unordered_map<TermId, size_t> known_index;
+
   /// Inference rules
   std::vector<InferenceRule> rules;
+
+  /// Indexes the consequences of all rules which can be used in
+  /// backward_prove, mapping to their rule indices
+  DiscriminationTree consequence_index;
+
+  /// Indexes every term in known, mapping to its index there
+  DiscriminationTree known_terms_index;
+
+  /// For each rule, every tuple of theorems with indices below
+  /// this has already been joined
+  std::vector<size_t> rule_watermarks;
+
+  /// The number of theorems and rules at some moment. Anything
+  /// learned since then changes this.
+  using Epoch = std::pair<size_t, size_t>;
+
+  /// Returns the current epoch
+  Epoch epoch() const noexcept;
+
+  /// Goals which backward_prove has failed to prove, mapped to
+  /// the most passes any such attempt was given. Only valid
+  /// during failed_goals_epoch.
+  std::unordered_map<TermId, int> failed_goals;
+
+  /// The epoch failed_goals was recorded in
+  Epoch failed_goals_epoch = {0, 0};
+
+  /// Guards failed_goals and failed_goals_epoch
+  std::mutex failed_goals_mutex;
+
+  /// The value of lowest_pruned_depth when nothing was pruned
+  constexpr static size_t no_pruned_depth = SIZE_MAX;
+
+  /// The backward_prove state of a single thread
+  struct SearchPath {
+    /// The goals on the current backward_prove path, mapped to
+    /// their depths along it
+    std::unordered_map<TermId, size_t> goal_depths;
+
+    /// The lowest depth of any goal whose revisit was pruned
+    /// since the current backward_prove goal was pushed
+    size_t lowest_pruned_depth = no_pruned_depth;
+
+    /// If given, backward_prove gives up once it is cancelled
+    const Cancellation *cancellation = nullptr;
+
+    /// How many more goals backward_prove may examine before
+    /// giving up
+    size_t steps_left = SIZE_MAX;
+
+    /// If given, every goal which backward_prove failed to
+    /// prove (without being cut short) is added to it
+    std::unordered_set<TermId> *stuck = nullptr;
+  };
+
+  /// The calling thread's search path. Paths are per thread so
+  /// that parallel_prove workers do not see each other's goals.
+  static thread_local SearchPath path;
+
+  /// Guards known, known_index and known_terms_index, so that
+  /// backward_prove may run on several threads at once.
+  /// forward_prove must only ever run on one.
+  mutable std::shared_mutex known_mutex;
+
+  /// When start_limits was last called
+  std::chrono::steady_clock::time_point limits_started =
+      std::chrono::steady_clock::now();
+
+  /// The number of theorems known when start_limits was last
+  /// called
+  size_t limits_theorems = 0;
+
+  /// The number of goals examined since start_limits
+  std::atomic<size_t> limits_nodes = 0;
+
+  /// The number of calls to over_limit since start_limits,
+  /// since memory is only measured on some of them
+  mutable std::atomic<size_t> limits_checks = 0;
+
+  /// The first limit exceeded since start_limits
+  mutable std::atomic<Limit> limit_hit = NO_LIMIT;
+
+  /// How many levels of goals parallel_prove spreads over the
+  /// pool before handing them to backward_prove
+  int spawn_depth = 3;
+
+  /// How many threads parallel_prove and forward_prove may
+  /// use. Forward passes are parallel iff this is above 1.
+  size_t threads = 1;
+
+  /// If true, parallel_prove also proves the requirements of
+  /// each rule at once, rather than one after another
+  bool and_parallel = false;
+
+  /// The pool of threads, started on first use
+  std::unique_ptr<WorkStealingPool> pool;
+
+  /// Gets the pool, (re)starting it if threads has changed
+  WorkStealingPool &get_pool();
+
+  /// Returns true iff _what is known to fail with _passes
+  bool known_failure(const TermId &_what, const int &_passes);
+
+  /// Records that _what failed with _passes, if nothing was
+  /// learned since _started
+  void record_failure(const TermId &_what, const int &_passes,
+                      const Epoch &_started);
 };
 
 std::ostream &operator<<(std::ostream &,
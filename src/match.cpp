@@ -0,0 +1,74 @@
+/**
+ * @brief Match program compilation and execution
+ */
+
+#include "match.hpp"
+
+Bindings no_bindings() noexcept {
+  Bindings out;
+  out.fill(unbound);
+  return out;
+}
+
+MatchProgram MatchProgram::compile(const TermId &_schema) {
+  MatchProgram out;
+  std::vector<TermId> pending = {_schema};
+  while (!pending.empty()) {
+    const TermId t = pending.back();
+    pending.pop_back();
+
+    const int32_t var =
+        symbols.variable_index(term_store.head(t));
+    if (var >= 0) {
+      out.code.push_back({Instruction::VAR, 0, (uint32_t)var});
+    } else if (term_store.is_ground(t)) {
+      // Hash-consing makes this a single compare
+      out.code.push_back({Instruction::EQUAL, t, 0});
+    } else {
+      const auto children = term_store.children(t);
+      out.code.push_back({Instruction::HEAD, term_store.head(t),
+                          (uint32_t)children.size()});
+      pending.insert(pending.end(), children.rbegin(),
+                     children.rend());
+    }
+  }
+  return out;
+}
+
+bool MatchProgram::run(const TermId &_term,
+                       Bindings &_registers) const {
+  thread_local std::vector<TermId> stack;
+  stack.clear();
+  stack.push_back(_term);
+
+  for (const auto &instruction : code) {
+    const TermId t = stack.back();
+    stack.pop_back();
+
+    switch (instruction.op) {
+    case Instruction::HEAD: {
+      const auto children = term_store.children(t);
+      if (term_store.head(t) != instruction.what ||
+          children.size() != instruction.arg) {
+        return false;
+      }
+      stack.insert(stack.end(), children.rbegin(),
+                   children.rend());
+    } break;
+    case Instruction::EQUAL: {
+      if (t != instruction.what) {
+        return false;
+      }
+    } break;
+    case Instruction::VAR: {
+      TermId &reg = _registers[instruction.arg];
+      if (reg == unbound) {
+        reg = t;
+      } else if (reg != t) {
+        return false;
+      }
+    } break;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,66 @@
+/**
+ * @brief Inference rule patterns compiled into match programs
+ */
+
+#pragma once
+
+#include "symbol.hpp"
+#include "term.hpp"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// The register value of a free variable which is not yet bound
+const static TermId unbound =
+    std::numeric_limits<TermId>::max();
+
+/// The most free variables a single rule may have
+const static uint32_t max_free_variables = 32;
+
+/// The values of a rule's free variables, indexed by variable
+/// number
+using Bindings = std::array<TermId, max_free_variables>;
+
+/// Returns bindings with every variable unbound
+Bindings no_bindings() noexcept;
+
+/// A schema compiled into a linear sequence of instructions
+/// over a stack of subterms. A schema is a pattern whose free
+/// variables have been replaced by numbered variable symbols
+/// (see SymbolTable::variable). Each variable is a register,
+/// shared between all the programs of a rule: The first
+/// program to reach a variable binds it, and every later
+/// occurrence must agree.
+class MatchProgram {
+public:
+  /// A single match instruction
+  struct Instruction {
+    /// What this instruction does to the top of the stack
+    enum Op : uint8_t {
+      HEAD,  /// Pop; require symbol and arity; push children
+      EQUAL, /// Pop; require it to be exactly term
+      VAR,   /// Pop; bind register slot or require equality
+    };
+
+    /// The operation
+    Op op;
+
+    /// The symbol (for HEAD) or the term (for EQUAL)
+    uint32_t what;
+
+    /// The arity (for HEAD) or the register (for VAR)
+    uint32_t arg;
+  };
+
+  /// Compiles a schema
+  static MatchProgram compile(const TermId &_schema);
+
+  /// Runs this program against _term, binding registers as
+  /// needed. Returns true iff _term matches. On failure, the
+  /// registers may be partially bound.
+  bool run(const TermId &_term, Bindings &_registers) const;
+
+  /// The instructions, in order
+  std::vector<Instruction> code;
+};
@@ -52,9 +52,8 @@ void TokenStream::expect(std::set<std::string> what) {
 
     throw std::runtime_error(
         "Expected " + what_ss.str() + ", but saw " +
-        cur_tok.text + " at " + cur_tok.file.string() + ":" +
-        std::to_string(cur_tok.line) + "." +
-        std::to_string(cur_tok.col));
+        cur_tok.text + " at " +
+        source_locations.to_string(cur_tok.location));
   }
   next();
 }
@@ -125,11 +124,9 @@ TokenStream lex_text(const std::string &text,
   return TokenStream(out);
 }
 
-TokenStream lex_file(const std::filesystem::path &fp) {
-  std::ifstream f(fp);
-  if (!f.is_open()) {
-    throw std::runtime_error("Failed to open " + fp.string());
-  }
+TokenStream lex_file_text(const std::string &contents,
+                          const std::filesystem::path &fp) {
+  std::istringstream f(contents);
   std::string line, text;
   while (!f.eof()) {
     std::getline(f, line);
@@ -138,15 +135,23 @@ TokenStream lex_file(const std::filesystem::path &fp) {
   return lex_text(text, fp);
 }
 
+TokenStream lex_file(const std::filesystem::path &fp) {
+  std::ifstream f(fp, std::ios::binary);
+  if (!f.is_open()) {
+    throw std::runtime_error("Failed to open " + fp.string());
+  }
+  std::stringstream contents;
+  contents << f.rdbuf();
+  return lex_file_text(contents.str(), fp);
+}
+
 ASTNode::ASTNode(const Token &_text,
                  const std::vector<ASTNode> &_children)
     : text(_text), children(_children) {
-  if (text.file == "N/A") {
+  if (text.location == 0) {
     for (const auto &child : children) {
-      if (child.text.file != "N/A") {
-        text.file = child.text.file;
-        text.line = child.text.line;
-        text.col = child.text.col;
+      if (child.text.location != 0) {
+        text.location = child.text.location;
         break;
       }
     }
@@ -387,9 +392,16 @@ ASTNode Parser::parse_statement() {
 
     ts.expect({"deduce"});
     ASTNode deduce_block(Token("DEDUCE"), {parse_expr()});
-    return ASTNode(
+    ASTNode out(
         Token("RULE"),
         {over_block, given_block, deduce_block, ASTNode(name)});
+
+    // Optionally, what best-first search charges for using it
+    if (ts.cur().text == "cost") {
+      ts.next();
+      out.children.push_back(ASTNode(ts.cur_next()));
+    }
+    return out;
   } else {
     throw std::runtime_error(
         "Unexpected statement start token '" + t + "'");
@@ -563,8 +575,8 @@ ASTNode Parser::parse_method() {
 // parser all of its own.
 ASTNode Parser::parse_expr() {
   const static std::set<std::string> expression_terminators = {
-      ",",      ";", "requires", "ensures", "given",
-      "deduce", "{", "}",        "=",       "]"};
+      ",", ";", "requires", "ensures", "given", "deduce",
+      "cost", "{", "}", "=", "]"};
   const static std::set<std::string> keywords = {
       "not", "and", "or", "implies", "iff"};
 
@@ -4,6 +4,7 @@
 
 static_assert(__cplusplus >= 2020'00ULL);
 
+#include "symbol.hpp"
 #include <compare>
 #include <cstdint>
 #include <filesystem>
@@ -18,20 +19,18 @@ struct Token {
   /// The text at this file location
   std::string text = "";
 
-  /// The file this token came from
-  std::filesystem::path file = "N/A";
+  /// Where this token came from, as an index into the global
+  /// source_locations table (zero if unknown)
+  LocationId location = 0;
 
-  /// The line within the file
-  uintmax_t line = 0;
-
-  /// The column within the line within the file
-  uintmax_t col = 0;
-
-  /// Construct a token
+  /// Construct a token. A location is only recorded if a file
+  /// is given.
   Token(const std::string &_t = "",
         const std::filesystem::path &_f = "",
         const uintmax_t &_l = 0, const uintmax_t &_c = 0)
-      : text(_t), file(_f), line(_l), col(_c) {
+      : text(_t), location(_f.empty() ? 0
+                                      : source_locations.add(
+                                            _f, _l, _c)) {
   }
 
   /// Lower-level constructor, because for some reason this
@@ -77,6 +76,11 @@ public:
 TokenStream lex_text(const std::string &text,
                      const std::filesystem::path &fp);
 
+/// Lexes the contents of a file as lex_file would, without
+/// reading it again
+TokenStream lex_file_text(const std::string &contents,
+                          const std::filesystem::path &fp);
+
 TokenStream lex_file(const std::filesystem::path &fp);
 
 /// A single node in an Abstract Syntax Tree (AST)
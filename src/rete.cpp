@@ -0,0 +1,110 @@
+/**
+ * @brief An incremental match network for forward rules
+ */
+
+#include "rete.hpp"
+
+bool ReteNetwork::add_rule(
+    const uint32_t &_rule,
+    const std::vector<MatchProgram> &_requirements,
+    std::vector<Match> &_out, const Stop &_stop) {
+  nodes.push_back({_rule,
+                   _requirements,
+                   std::vector<std::vector<size_t>>(
+                       _requirements.size()),
+                   std::vector<std::vector<Token>>(
+                       _requirements.size())});
+  auto &node = nodes.back();
+
+  // A rule with no requirements matches exactly once
+  if (_requirements.empty()) {
+    _out.push_back({_rule, no_bindings(), {}});
+    return true;
+  }
+
+  node.beta[0].push_back({no_bindings(), {}});
+  for (size_t i = 0; i < facts.size(); ++i) {
+    if (!activate(node, i, _out, _stop)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReteNetwork::add_fact(const size_t &_index,
+                           const TermId &_term,
+                           std::vector<Match> &_out,
+                           const Stop &_stop) {
+  facts.push_back({_index, _term});
+  for (auto &node : nodes) {
+    if (!activate(node, facts.size() - 1, _out, _stop)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ReteNetwork::n_facts() const noexcept {
+  return facts.size();
+}
+
+bool ReteNetwork::activate(RuleNode &_node, const size_t &_fact,
+                           std::vector<Match> &_out,
+                           const Stop &_stop) {
+  const Fact &fact = facts[_fact];
+
+  // Slots are visited in order, so a token using this fact in
+  // an earlier slot is already in beta when a later slot joins
+  // with it, and each match is made once
+  for (size_t slot = 0; slot < _node.programs.size(); ++slot) {
+    Bindings alone = no_bindings();
+    if (!_node.programs[slot].run(fact.term, alone)) {
+      continue;
+    }
+    _node.alpha[slot].push_back(_fact);
+
+    // Only tokens stored before this join, since extend adds
+    // to later levels only
+    const size_t n_tokens = _node.beta[slot].size();
+    for (size_t i = 0; i < n_tokens; ++i) {
+      Token next = _node.beta[slot][i];
+      if (!_node.programs[slot].run(fact.term, next.bindings)) {
+        continue;
+      }
+      next.premises.push_back(fact.index);
+      if (!extend(_node, slot + 1, std::move(next), _out,
+                  _stop)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ReteNetwork::extend(RuleNode &_node, const size_t &_slot,
+                         Token _token, std::vector<Match> &_out,
+                         const Stop &_stop) {
+  if (_stop && _stop()) {
+    return false;
+  }
+  if (_slot == _node.programs.size()) {
+    _out.push_back({_node.rule, _token.bindings,
+                    std::move(_token.premises)});
+    return true;
+  }
+
+  _node.beta[_slot].push_back(_token);
+  for (const auto &position : _node.alpha[_slot]) {
+    Token next = _token;
+    if (!_node.programs[_slot].run(facts[position].term,
+                                   next.bindings)) {
+      continue;
+    }
+    next.premises.push_back(facts[position].index);
+    if (!extend(_node, _slot + 1, std::move(next), _out,
+                _stop)) {
+      return false;
+    }
+  }
+  return true;
+}
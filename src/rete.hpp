@@ -0,0 +1,111 @@
+/**
+ * @brief An incremental match network for forward rules
+ */
+
+#pragma once
+
+#include "match.hpp"
+#include "term.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// A Rete network over the requirements of forward rules. Each
+/// requirement has an alpha memory of the facts which match it
+/// alone, and each prefix of a rule's requirements has a beta
+/// memory of the consistent partial matches over it. Adding a
+/// fact only joins that fact against what is already stored,
+/// so every complete match is produced exactly once, as soon as
+/// its last fact arrives.
+class ReteNetwork {
+public:
+  /// A complete match of a rule's requirements
+  struct Match {
+    /// The rule matched
+    uint32_t rule;
+
+    /// The bindings made by matching its requirements
+    Bindings bindings;
+
+    /// The facts which matched each requirement, in order
+    std::vector<size_t> premises;
+  };
+
+  /// Called as matching goes on, and returns true to stop it
+  using Stop = std::function<bool()>;
+
+  /// Adds rule _rule with the given requirement programs (which
+  /// share registers). Facts already added are matched against
+  /// it, and any complete matches are appended to _out. Returns
+  /// false if _stop stopped it first, in which case some
+  /// matches will never be made and the network should be
+  /// discarded.
+  bool add_rule(const uint32_t &_rule,
+                const std::vector<MatchProgram> &_requirements,
+                std::vector<Match> &_out,
+                const Stop &_stop = nullptr);
+
+  /// Adds a fact, appending every match it completes to _out.
+  /// Returns false if _stop stopped it first, as above.
+  bool add_fact(const size_t &_index, const TermId &_term,
+                std::vector<Match> &_out,
+                const Stop &_stop = nullptr);
+
+  /// The number of facts added so far
+  size_t n_facts() const noexcept;
+
+protected:
+  /// A fact which has been added
+  struct Fact {
+    /// The index it was added with
+    size_t index;
+
+    /// The term itself
+    TermId term;
+  };
+
+  /// A consistent match of some prefix of a rule's requirements
+  struct Token {
+    /// The bindings made so far
+    Bindings bindings;
+
+    /// The facts matched so far, in order
+    std::vector<size_t> premises;
+  };
+
+  /// The memories of a single rule
+  struct RuleNode {
+    /// The rule this is for
+    uint32_t rule;
+
+    /// Matches each requirement
+    std::vector<MatchProgram> programs;
+
+    /// For each requirement, the positions in facts of those
+    /// which match it alone
+    std::vector<std::vector<size_t>> alpha;
+
+    /// For each k below the number of requirements, the tokens
+    /// over the first k requirements
+    std::vector<std::vector<Token>> beta;
+  };
+
+  /// Adds a fact to a single rule's memories, returning false
+  /// if _stop stopped it
+  bool activate(RuleNode &_node, const size_t &_fact,
+                std::vector<Match> &_out, const Stop &_stop);
+
+  /// Stores _token as a match of the first _slot requirements
+  /// of _node, then joins it with every stored fact which
+  /// could match the next one. Returns false if _stop stopped
+  /// it.
+  bool extend(RuleNode &_node, const size_t &_slot,
+              Token _token, std::vector<Match> &_out,
+              const Stop &_stop);
+
+  /// Every rule, in the order added
+  std::vector<RuleNode> nodes;
+
+  /// Every fact, in the order added
+  std::vector<Fact> facts;
+};
@@ -0,0 +1,451 @@
+/**
+ * @brief Binary snapshots of everything a Core has learned
+ */
+
+#include "snapshot.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+/*
+Layout, in native byte order. Every count and index is a
+uint32_t, and strings are a length followed by their bytes.
+
+  magic          "VRLYSNP4"
+  base           the number of rules and of theorems before
+                 those in the snapshot, which it refers to by
+                 index but does not contain
+  files          count, then per file done (or skipped) its
+                 uint64_t content hash and canonical path
+  symbols        count, then per symbol its int32_t variable
+                 index (-1 if not a variable) and, if not a
+                 variable, its text
+  terms          count, then per term its symbol, arity and
+                 children (each an earlier term)
+  rules          count, then per rule whether it is named, its
+                 name if so, its free variables (symbols), its
+                 requirements (terms), its consequence (term)
+                 and its uint64_t cost
+  theorems       count, then per theorem its term, its int32_t
+                 rule (-1 for axioms) and its premises (earlier
+                 theorems)
+  axioms         count, then theorems
+  proven         count, then theorems
+*/
+
+/// Identifies a snapshot, and the version of its layout
+static const char snapshot_magic[8] = {'V', 'R', 'L', 'Y',
+                                       'S', 'N', 'P', '4'};
+
+/// Appends the raw bytes of _what to _out
+template <typename T>
+static void put(std::string &_out, const T &_what) {
+  _out.append(reinterpret_cast<const char *>(&_what),
+              sizeof(T));
+}
+
+/// Appends a length-prefixed string to _out
+static void put_string(std::string &_out,
+                       const std::string &_what) {
+  put<uint32_t>(_out, _what.size());
+  _out.append(_what);
+}
+
+std::string snapshot(const Core &_core,
+                     const size_t &_first_rule,
+                     const size_t &_first_theorem,
+                     const size_t &_first_file) {
+  const auto &im = _core.im;
+
+  // Number every term used, children first, and every symbol
+  // those terms use
+  std::unordered_map<SymbolId, uint32_t> symbol_ids;
+  std::vector<SymbolId> symbol_order;
+  std::unordered_map<TermId, uint32_t> term_ids;
+  std::vector<TermId> term_order;
+  const auto number_symbol = [&](const SymbolId &_symbol) {
+    if (symbol_ids.emplace(_symbol, symbol_order.size())
+            .second) {
+      symbol_order.push_back(_symbol);
+    }
+  };
+  const auto number_term = [&](const TermId &_root) {
+    std::vector<std::pair<TermId, bool>> stack = {
+        {_root, false}};
+    while (!stack.empty()) {
+      const auto [term, expanded] = stack.back();
+      if (term_ids.contains(term)) {
+        stack.pop_back();
+        continue;
+      }
+      if (!expanded) {
+        stack.back().second = true;
+        for (const auto &child : term_store.children(term)) {
+          stack.push_back({child, false});
+        }
+        continue;
+      }
+      stack.pop_back();
+      number_symbol(term_store.head(term));
+      term_ids[term] = term_order.size();
+      term_order.push_back(term);
+    }
+  };
+
+  const auto rules = std::span(im.rules).subspan(_first_rule);
+  const auto known =
+      std::span(im.known).subspan(_first_theorem);
+  for (const auto &rule : rules) {
+    for (const auto &fv : rule.free_variables) {
+      number_symbol(fv);
+    }
+    for (const auto &req : rule.requirements) {
+      number_term(req);
+    }
+    number_term(rule.consequence);
+  }
+  for (const auto &thm : known) {
+    number_term(thm.thm);
+  }
+
+  std::string out(snapshot_magic, sizeof(snapshot_magic));
+  put<uint32_t>(out, _first_rule);
+  put<uint32_t>(out, _first_theorem);
+
+  const auto files =
+      std::span(_core.file_log).subspan(_first_file);
+  put<uint32_t>(out, files.size());
+  for (const auto &file : files) {
+    put<uint64_t>(out, file.second);
+    put_string(out, file.first);
+  }
+
+  put<uint32_t>(out, symbol_order.size());
+  for (const auto &symbol : symbol_order) {
+    const int32_t variable = symbols.variable_index(symbol);
+    put<int32_t>(out, variable);
+    if (variable < 0) {
+      put_string(out, symbols.text(symbol));
+    }
+  }
+
+  put<uint32_t>(out, term_order.size());
+  for (const auto &term : term_order) {
+    const auto children = term_store.children(term);
+    put<uint32_t>(out, symbol_ids.at(term_store.head(term)));
+    put<uint32_t>(out, children.size());
+    for (const auto &child : children) {
+      put<uint32_t>(out, term_ids.at(child));
+    }
+  }
+
+  put<uint32_t>(out, rules.size());
+  for (const auto &rule : rules) {
+    put<uint32_t>(out, rule.name.has_value());
+    if (rule.name.has_value()) {
+      put_string(out, rule.name.value());
+    }
+    put<uint32_t>(out, rule.free_variables.size());
+    for (const auto &fv : rule.free_variables) {
+      put<uint32_t>(out, symbol_ids.at(fv));
+    }
+    put<uint32_t>(out, rule.requirements.size());
+    for (const auto &req : rule.requirements) {
+      put<uint32_t>(out, term_ids.at(req));
+    }
+    put<uint32_t>(out, term_ids.at(rule.consequence));
+    put<uint64_t>(out, rule.cost);
+  }
+
+  put<uint32_t>(out, known.size());
+  for (const auto &thm : known) {
+    put<uint32_t>(out, term_ids.at(thm.thm));
+    put<int32_t>(out, thm.rule_index);
+    put<uint32_t>(out, thm.premises.size());
+    for (const auto &premise : thm.premises) {
+      put<uint32_t>(out, premise);
+    }
+  }
+
+  for (const auto *indices :
+       {&_core.axioms, &_core.proven_theorems}) {
+    put<uint32_t>(out, indices->size());
+    for (const auto &index : *indices) {
+      put<uint32_t>(out, index);
+    }
+  }
+  return out;
+}
+
+void save_snapshot(const Core &_core,
+                   const std::filesystem::path &_fp,
+                   const size_t &_first_rule,
+                   const size_t &_first_theorem,
+                   const size_t &_first_file) {
+  const std::string out = snapshot(_core, _first_rule,
+                                   _first_theorem, _first_file);
+  std::ofstream f(_fp, std::ios::binary);
+  if (!f.is_open()) {
+    throw std::runtime_error("Failed to open snapshot " +
+                             _fp.string());
+  }
+  f.write(out.data(), out.size());
+  if (!f) {
+    throw std::runtime_error("Failed to write snapshot " +
+                             _fp.string());
+  }
+}
+
+/// A read-only memory mapping of a whole file
+class MappedFile {
+public:
+  /// Maps the file at _fp, throwing on failure
+  MappedFile(const std::filesystem::path &_fp) {
+    const int fd = open(_fp.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open snapshot " +
+                               _fp.string());
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      throw std::runtime_error("Failed to stat snapshot " +
+                               _fp.string());
+    }
+    size = info.st_size;
+    if (size > 0) {
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error("Failed to map snapshot " +
+                               _fp.string());
+    }
+  }
+
+  /// Not copyable, since it owns the mapping
+  MappedFile(const MappedFile &) = delete;
+
+  /// Unmaps the file
+  ~MappedFile() {
+    if (data != nullptr && data != MAP_FAILED) {
+      munmap(data, size);
+    }
+  }
+
+  /// The start of the mapping, or null if the file is empty
+  void *data = nullptr;
+
+  /// The size of the mapping in bytes
+  size_t size = 0;
+};
+
+/// Reads fields out of a mapped snapshot in order
+class SnapshotReader {
+public:
+  /// Reads the _size bytes starting at _data
+  SnapshotReader(const void *_data, const size_t &_size,
+                 const std::filesystem::path &_fp)
+      : at(static_cast<const char *>(_data)), end(at + _size),
+        fp(_fp) {
+  }
+
+  /// Reads a single field. Fields are not aligned, so they are
+  /// copied out rather than cast in place.
+  template <typename T> T get() {
+    T out;
+    std::memcpy(&out, take(sizeof(T)), sizeof(T));
+    return out;
+  }
+
+  /// Reads a length-prefixed string
+  std::string get_string() {
+    const uint32_t n = get<uint32_t>();
+    return std::string(take(n), n);
+  }
+
+  /// Reads an index, which must be below _bound
+  uint32_t get_index(const size_t &_bound) {
+    const uint32_t out = get<uint32_t>();
+    if (out >= _bound) {
+      throw std::runtime_error("Bad index in snapshot " +
+                               fp.string());
+    }
+    return out;
+  }
+
+  /// Skips _n bytes, returning where they started
+  const char *take(const size_t &_n) {
+    if ((size_t)(end - at) < _n) {
+      throw std::runtime_error("Truncated snapshot " +
+                               fp.string());
+    }
+    const char *out = at;
+    at += _n;
+    return out;
+  }
+
+protected:
+  /// The next unread byte
+  const char *at;
+
+  /// One past the last byte
+  const char *end;
+
+  /// For errors
+  std::filesystem::path fp;
+};
+
+/// Reads the magic and base of a snapshot, throwing if it is
+/// of another version
+static std::pair<uint32_t, uint32_t>
+read_base(SnapshotReader &_in,
+          const std::filesystem::path &_fp) {
+  if (std::memcmp(_in.take(sizeof(snapshot_magic)),
+                  snapshot_magic,
+                  sizeof(snapshot_magic)) != 0) {
+    throw std::runtime_error("Not a version 4 snapshot: " +
+                             _fp.string());
+  }
+  const uint32_t base_rules = _in.get<uint32_t>();
+  return {base_rules, _in.get<uint32_t>()};
+}
+
+/// Reads the files of a snapshot
+static std::vector<Core::FileKey>
+read_files(SnapshotReader &_in) {
+  std::vector<Core::FileKey> out(_in.get<uint32_t>());
+  for (auto &file : out) {
+    file.second = _in.get<uint64_t>();
+    file.first = _in.get_string();
+  }
+  return out;
+}
+
+std::vector<Core::FileKey>
+snapshot_files(const std::filesystem::path &_fp) {
+  const MappedFile file(_fp);
+  SnapshotReader in(file.data, file.size, _fp);
+  read_base(in, _fp);
+  return read_files(in);
+}
+
+void load_snapshot(Core &_core,
+                   const std::filesystem::path &_fp) {
+  auto &im = _core.im;
+  const MappedFile file(_fp);
+  SnapshotReader in(file.data, file.size, _fp);
+
+  // Anything below the base must already be here
+  const auto [base_rules, base_theorems] = read_base(in, _fp);
+  if ((base_rules != 0 || base_theorems != 0) &&
+      (im.rules.size() != base_rules ||
+       im.known.size() != base_theorems)) {
+    throw std::runtime_error("Snapshot " + _fp.string() +
+                             " does not build on this state");
+  }
+
+  // So that these files are not done again
+  for (const auto &key : read_files(in)) {
+    _core.log_file(key);
+  }
+
+  std::vector<SymbolId> symbol_map(in.get<uint32_t>());
+  for (auto &symbol : symbol_map) {
+    const int32_t variable = in.get<int32_t>();
+    symbol = variable >= 0 ? symbols.variable(variable)
+                           : symbols.intern(in.get_string());
+  }
+
+  std::vector<TermId> term_map(in.get<uint32_t>());
+  for (size_t i = 0; i < term_map.size(); ++i) {
+    const SymbolId head =
+        symbol_map[in.get_index(symbol_map.size())];
+    std::vector<TermId> children(in.get<uint32_t>());
+    for (auto &child : children) {
+      child = term_map[in.get_index(i)];
+    }
+    term_map[i] = term_store.make(head, children);
+  }
+
+  const size_t first_rule = im.rules.size();
+  const uint32_t n_rules = in.get<uint32_t>();
+  const auto rule_index = [&](const int32_t &_index) {
+    if (_index >= (int64_t)(base_rules + n_rules)) {
+      throw std::runtime_error("Bad rule in snapshot " +
+                               _fp.string());
+    }
+    return _index < (int64_t)base_rules
+               ? _index
+               : first_rule + (_index - base_rules);
+  };
+  for (uint32_t i = 0; i < n_rules; ++i) {
+    std::optional<std::string> name;
+    if (in.get<uint32_t>() != 0) {
+      name = in.get_string();
+    }
+    std::set<SymbolId> free_variables;
+    const uint32_t n_fvs = in.get<uint32_t>();
+    for (uint32_t j = 0; j < n_fvs; ++j) {
+      free_variables.insert(
+          symbol_map[in.get_index(symbol_map.size())]);
+    }
+    std::vector<TermId> requirements(in.get<uint32_t>());
+    for (auto &req : requirements) {
+      req = term_map[in.get_index(term_map.size())];
+    }
+    const TermId consequence =
+        term_map[in.get_index(term_map.size())];
+
+    InferenceMaker::InferenceRule rule(
+        free_variables, requirements, consequence);
+    rule.name = name;
+    rule.cost = in.get<uint64_t>();
+    im.add_rule(rule);
+  }
+
+  // Theorems already known keep their place
+  std::vector<size_t> theorem_map(in.get<uint32_t>());
+  const auto theorem = [&](const size_t &_n_loaded) -> size_t {
+    const uint32_t index =
+        in.get_index(base_theorems + _n_loaded);
+    return index < base_theorems
+               ? index
+               : theorem_map[index - base_theorems];
+  };
+  for (size_t i = 0; i < theorem_map.size(); ++i) {
+    const TermId thm = term_map[in.get_index(term_map.size())];
+    const int32_t rule = in.get<int32_t>();
+    std::list<size_t> premises;
+    const uint32_t n_premises = in.get<uint32_t>();
+    for (uint32_t j = 0; j < n_premises; ++j) {
+      premises.push_back(theorem(i));
+    }
+
+    const int existing = im.has(thm);
+    if (existing >= 0) {
+      theorem_map[i] = existing;
+    } else if (rule < 0) {
+      theorem_map[i] = im.add_axiom(thm);
+    } else {
+      bool actually_added = true;
+      theorem_map[i] = im.add_theorem(thm, rule_index(rule),
+                                      premises, actually_added)
+                           .index;
+    }
+  }
+
+  for (auto *indices :
+       {&_core.axioms, &_core.proven_theorems}) {
+    const uint32_t n = in.get<uint32_t>();
+    for (uint32_t j = 0; j < n; ++j) {
+      indices->insert(theorem(theorem_map.size()));
+    }
+  }
+}
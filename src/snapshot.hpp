@@ -0,0 +1,44 @@
+/**
+ * @brief Binary snapshots of everything a Core has learned
+ */
+
+#pragma once
+
+#include "core.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// Serializes the rules, theorems (with their premises),
+/// axioms, proven theorems and logged files of _core. Only the
+/// terms and symbols these use are written, children before
+/// parents, so loading never needs to parse anything. Rules
+/// before _first_rule and theorems before _first_theorem are
+/// left out and referred to by index, so such a snapshot can
+/// only be loaded on top of exactly that many rules and
+/// theorems. Files logged before _first_file are left out.
+std::string snapshot(const Core &_core,
+                     const size_t &_first_rule = 0,
+                     const size_t &_first_theorem = 0,
+                     const size_t &_first_file = 0);
+
+/// Writes snapshot(_core, ...) to _fp, throwing on failure
+void save_snapshot(const Core &_core,
+                   const std::filesystem::path &_fp,
+                   const size_t &_first_rule = 0,
+                   const size_t &_first_theorem = 0,
+                   const size_t &_first_file = 0);
+
+/// Reads only the files logged in the snapshot at _fp
+std::vector<Core::FileKey>
+snapshot_files(const std::filesystem::path &_fp);
+
+/// Memory-maps the snapshot at _fp and adds everything in it to
+/// _core, after whatever _core already knows. Theorems _core
+/// already knows are reused rather than added again, and the
+/// files it logs are logged as done, so they are skipped if
+/// included again. Throws if the file is missing, truncated or
+/// of another version, or if it does not build on what _core
+/// knows.
+void load_snapshot(Core &_core,
+                   const std::filesystem::path &_fp);
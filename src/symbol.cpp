@@ -0,0 +1,99 @@
+/**
+ * @brief Process-wide symbol and source location tables
+ */
+
+#include "symbol.hpp"
+#include <stdexcept>
+
+SymbolTable symbols;
+SourceLocations source_locations;
+
+SymbolId SymbolTable::intern(const std::string &_text) {
+  const auto it = ids.find(_text);
+  if (it != ids.end()) {
+    return it->second;
+  }
+  const SymbolId out = texts.size();
+  texts.push_back(_text);
+  ids.insert({_text, out});
+  variable_indices.push_back(-1);
+  return out;
+}
+
+SymbolId SymbolTable::variable(const uint32_t &_index) {
+  // Lexed tokens never contain spaces
+  const SymbolId out =
+      intern("<var " + std::to_string(_index) + ">");
+  variable_indices[out] = _index;
+  return out;
+}
+
+int32_t SymbolTable::variable_index(
+    const SymbolId &_id) const noexcept {
+  if (_id >= variable_indices.size()) {
+    return -1;
+  }
+  return variable_indices[_id];
+}
+
+const std::string &
+SymbolTable::text(const SymbolId &_id) const {
+  if (_id >= texts.size()) {
+    throw std::runtime_error("Invalid symbol id " +
+                             std::to_string(_id));
+  }
+  return texts[_id];
+}
+
+size_t SymbolTable::size() const noexcept {
+  return texts.size();
+}
+
+SourceLocations::SourceLocations()
+    : locations({{0, 0, 0}}), files({"N/A"}) {
+}
+
+LocationId
+SourceLocations::add(const std::filesystem::path &_file,
+                     const uintmax_t &_line,
+                     const uintmax_t &_col) {
+  const auto it = file_ids.find(_file.string());
+  uint32_t file_id;
+  if (it != file_ids.end()) {
+    file_id = it->second;
+  } else {
+    file_id = files.size();
+    files.push_back(_file);
+    file_ids.insert({_file.string(), file_id});
+  }
+  locations.push_back(
+      {file_id, (uint32_t)_line, (uint32_t)_col});
+  return locations.size() - 1;
+}
+
+const SourceLocations::Entry &
+SourceLocations::get(const LocationId &_id) const {
+  if (_id >= locations.size()) {
+    return locations.front();
+  }
+  return locations[_id];
+}
+
+const std::filesystem::path &
+SourceLocations::file(const LocationId &_id) const {
+  return files[get(_id).file];
+}
+
+uintmax_t SourceLocations::line(const LocationId &_id) const {
+  return get(_id).line;
+}
+
+uintmax_t SourceLocations::col(const LocationId &_id) const {
+  return get(_id).col;
+}
+
+std::string
+SourceLocations::to_string(const LocationId &_id) const {
+  return file(_id).string() + ":" + std::to_string(line(_id)) +
+         "." + std::to_string(col(_id));
+}
@@ -0,0 +1,104 @@
+/**
+ * @brief Process-wide symbol and source location tables
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// A small integer standing in for some symbol text
+using SymbolId = uint32_t;
+
+/// A small integer standing in for a location in a source file.
+/// The zero location is "unknown".
+using LocationId = uint32_t;
+
+/// Maps symbol texts to small integers and back
+class SymbolTable {
+public:
+  /// Returns the id of the given text, creating it iff needed
+  SymbolId intern(const std::string &_text);
+
+  /// Gets the text behind a symbol id
+  const std::string &text(const SymbolId &_id) const;
+
+  /// Returns the symbol standing for the _index-th free
+  /// variable of a rule. Its text can never be lexed.
+  SymbolId variable(const uint32_t &_index);
+
+  /// The variable index of a symbol, or -1 if it is not one
+  int32_t variable_index(const SymbolId &_id) const noexcept;
+
+  /// The number of distinct symbols
+  size_t size() const noexcept;
+
+protected:
+  /// All texts, indexed by SymbolId
+  std::vector<std::string> texts;
+
+  /// The inverse of texts
+  std::unordered_map<std::string, SymbolId> ids;
+
+  /// The variable index of every symbol, or -1
+  std::vector<int32_t> variable_indices;
+};
+
+/// A side table of source locations, so that tokens and terms
+/// only need to carry a LocationId
+class SourceLocations {
+public:
+  /// Initializes the "unknown" location
+  SourceLocations();
+
+  /// Records a location and returns its id
+  LocationId add(const std::filesystem::path &_file,
+                 const uintmax_t &_line, const uintmax_t &_col);
+
+  /// The file a location is in
+  const std::filesystem::path &
+  file(const LocationId &_id) const;
+
+  /// The line within the file
+  uintmax_t line(const LocationId &_id) const;
+
+  /// The column within the line within the file
+  uintmax_t col(const LocationId &_id) const;
+
+  /// Formats a location as FILE:LINE.COL
+  std::string to_string(const LocationId &_id) const;
+
+protected:
+  /// A single location in a source file
+  struct Entry {
+    /// An index into files
+    uint32_t file;
+
+    /// The line within the file
+    uint32_t line;
+
+    /// The column within the line within the file
+    uint32_t col;
+  };
+
+  /// Gets a location by id, or the unknown one if invalid
+  const Entry &get(const LocationId &_id) const;
+
+  /// All locations, indexed by LocationId
+  std::vector<Entry> locations;
+
+  /// All files which have been referenced
+  std::vector<std::filesystem::path> files;
+
+  /// The inverse of files
+  std::unordered_map<std::string, uint32_t> file_ids;
+};
+
+/// The symbol table shared by everything in this process
+extern SymbolTable symbols;
+
+/// The source locations shared by everything in this process
+extern SourceLocations source_locations;
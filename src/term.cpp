@@ -0,0 +1,306 @@
+/**
+ * @brief Hash-consed term storage implementation
+ */
+
+#include "term.hpp"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+TermStore term_store;
+
+TermStore::TermStore()
+    : node_chunks(1ull << (32 - chunk_bits)),
+      child_chunks(1ull << (32 - chunk_bits)) {
+}
+
+std::optional<TermId>
+TermStore::find(const size_t &_hash, const SymbolId &_head,
+                const std::vector<TermId> &_children) const {
+  const auto [begin, end] = table.equal_range(_hash);
+  for (auto it = begin; it != end; ++it) {
+    const Node &candidate = node(it->second);
+    if (candidate.arity == _children.size() &&
+        candidate.head == _head &&
+        std::equal(_children.begin(), _children.end(),
+                   children(it->second).begin())) {
+      return it->second;
+    }
+  }
+  return {};
+}
+
+TermId TermStore::make(const SymbolId &_head,
+                       const std::vector<TermId> &_children) {
+  size_t hash = std::hash<SymbolId>{}(_head);
+  for (const auto &child : _children) {
+    hash ^= child + 0x9e3779b97f4a7c15ULL + (hash << 6) +
+            (hash >> 2);
+  }
+
+  // Return the existing node if there is one
+  {
+    std::shared_lock lock(mutex);
+    if (const auto found = find(hash, _head, _children)) {
+      return *found;
+    }
+  }
+
+  // Otherwise, create it (unless another thread just did)
+  std::unique_lock lock(mutex);
+  if (const auto found = find(hash, _head, _children)) {
+    return *found;
+  }
+
+  const static SymbolId replace_symbol =
+      symbols.intern("REPLACE");
+  uint8_t flags = 0;
+  if (symbols.variable_index(_head) >= 0) {
+    flags |= HAS_VARIABLE;
+  }
+  if (_head == replace_symbol) {
+    flags |= HAS_REPLACE;
+  }
+  uint32_t weight = 1;
+  for (const auto &child : _children) {
+    flags |= node(child).flags;
+    weight += node(child).weight;
+  }
+
+  // Keep the children within a single chunk
+  if (_children.size() > chunk_size) {
+    throw std::runtime_error("Term has too many children");
+  }
+  const uint32_t offset = n_children & (chunk_size - 1);
+  if (offset + _children.size() > chunk_size) {
+    n_children += chunk_size - offset;
+  }
+  const uint32_t first_child = n_children;
+  if (!_children.empty()) {
+    auto &chunk = child_chunks[first_child >> chunk_bits];
+    if (!chunk) {
+      chunk = std::make_unique<TermId[]>(chunk_size);
+    }
+    std::copy(_children.begin(), _children.end(),
+              chunk.get() + (first_child & (chunk_size - 1)));
+    n_children += _children.size();
+  }
+
+  const TermId out = n_nodes.load();
+  auto &chunk = node_chunks[out >> chunk_bits];
+  if (!chunk) {
+    chunk = std::make_unique<Node[]>(chunk_size);
+  }
+  chunk[out & (chunk_size - 1)] = {
+      .head = _head,
+      .first_child = first_child,
+      .arity = (uint32_t)_children.size(),
+      .hash = hash,
+      .flags = flags,
+      .weight = weight};
+  n_nodes.store(out + 1, std::memory_order_release);
+  table.insert({hash, out});
+  return out;
+}
+
+TermId TermStore::make(const std::string &_head,
+                       const std::vector<TermId> &_children) {
+  return make(symbols.intern(_head), _children);
+}
+
+TermId TermStore::intern(const ASTNode &_node) {
+  std::vector<TermId> children;
+  children.reserve(_node.children.size());
+  for (const auto &child : _node.children) {
+    children.push_back(intern(child));
+  }
+  return make(_node.text.text, children);
+}
+
+ASTNode TermStore::to_ast(const TermId &_id) const {
+  ASTNode out(text(_id));
+  for (const auto &child : children(_id)) {
+    out.children.push_back(to_ast(child));
+  }
+  return out;
+}
+
+const TermStore::Node &
+TermStore::node(const TermId &_id) const {
+  if (_id >= n_nodes.load(std::memory_order_acquire)) {
+    throw std::runtime_error("Invalid term id " +
+                             std::to_string(_id));
+  }
+  return node_chunks[_id >> chunk_bits]
+                    [_id & (chunk_size - 1)];
+}
+
+SymbolId TermStore::head(const TermId &_id) const {
+  return node(_id).head;
+}
+
+const std::string &TermStore::text(const TermId &_id) const {
+  return symbols.text(node(_id).head);
+}
+
+std::span<const TermId>
+TermStore::children(const TermId &_id) const {
+  const Node &n = node(_id);
+  if (n.arity == 0) {
+    return {};
+  }
+  return {child_chunks[n.first_child >> chunk_bits].get() +
+              (n.first_child & (chunk_size - 1)),
+          n.arity};
+}
+
+bool TermStore::contains(const TermId &_in,
+                         const TermId &_what) const {
+  if (_in == _what) {
+    return true;
+  }
+  for (const auto &child : children(_in)) {
+    if (contains(child, _what)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TermStore::contains_symbol(const TermId &_in,
+                                const SymbolId &_head) const {
+  if (head(_in) == _head) {
+    return true;
+  }
+  for (const auto &child : children(_in)) {
+    if (contains_symbol(child, _head)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TermId TermStore::replace(const TermId &_in,
+                          const TermId &_to_replace,
+                          const TermId &_replace_with) {
+  if (_in == _to_replace) {
+    return _replace_with;
+  }
+
+  // Copy the ids out first, since they are replaced in place
+  const auto old_children = children(_in);
+  std::vector<TermId> new_children(old_children.begin(),
+                                   old_children.end());
+  for (auto &child : new_children) {
+    child = replace(child, _to_replace, _replace_with);
+  }
+  return rebuild(_in, new_children);
+}
+
+TermId TermStore::replace(
+    const TermId &_in,
+    const std::list<std::pair<TermId, TermId>> &_replacements) {
+  for (const auto &p : _replacements) {
+    if (_in == p.first) {
+      return p.second;
+    }
+  }
+
+  const auto old_children = children(_in);
+  std::vector<TermId> new_children(old_children.begin(),
+                                   old_children.end());
+  for (auto &child : new_children) {
+    child = replace(child, _replacements);
+  }
+  return rebuild(_in, new_children);
+}
+
+TermId
+TermStore::instantiate(const TermId &_schema,
+                       std::span<const TermId> _bindings) {
+  if (!(node(_schema).flags & HAS_VARIABLE)) {
+    return _schema;
+  }
+  const int32_t var = symbols.variable_index(head(_schema));
+  if (var >= 0) {
+    return _bindings[var];
+  }
+
+  const auto old_children = children(_schema);
+  std::vector<TermId> new_children(old_children.begin(),
+                                   old_children.end());
+  for (auto &child : new_children) {
+    child = instantiate(child, _bindings);
+  }
+  return rebuild(_schema, new_children);
+}
+
+bool TermStore::is_ground(const TermId &_id) const {
+  return !(node(_id).flags & HAS_VARIABLE);
+}
+
+uint32_t TermStore::weight(const TermId &_id) const {
+  return node(_id).weight;
+}
+
+TermId
+TermStore::rebuild(const TermId &_in,
+                   const std::vector<TermId> &_children) {
+  const auto old_children = children(_in);
+  if (std::equal(_children.begin(), _children.end(),
+                 old_children.begin(), old_children.end())) {
+    return _in;
+  }
+  return make(head(_in), _children);
+}
+
+TermId TermStore::beta_star(const TermId &_in) {
+  if (!(node(_in).flags & HAS_REPLACE)) {
+    return _in;
+  }
+
+  const static SymbolId replace_symbol =
+      symbols.intern("REPLACE");
+  if (head(_in) == replace_symbol) {
+    // Apply beta reduction a single time, then recurse
+    const TermId A = children(_in)[0];
+    const TermId x = children(_in)[1];
+    const TermId B = children(_in)[2];
+    return beta_star(replace(A, x, B));
+  }
+
+  // Apply beta star to all children
+  const auto old_children = children(_in);
+  std::vector<TermId> new_children(old_children.begin(),
+                                   old_children.end());
+  for (auto &child : new_children) {
+    child = beta_star(child);
+  }
+  return rebuild(_in, new_children);
+}
+
+void TermStore::print(std::ostream &_strm,
+                      const TermId &_id) const {
+  if (children(_id).empty()) {
+    _strm << text(_id);
+  } else {
+    _strm << "(" << text(_id);
+    for (const auto &child : children(_id)) {
+      _strm << " ";
+      print(_strm, child);
+    }
+    _strm << ")";
+  }
+}
+
+std::string TermStore::to_string(const TermId &_id) const {
+  std::stringstream ss;
+  print(ss, _id);
+  return ss.str();
+}
+
+size_t TermStore::size() const noexcept {
+  return n_nodes.load();
+}
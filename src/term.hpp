@@ -0,0 +1,178 @@
+/**
+ * @brief Hash-consed term storage for the inference engine
+ */
+
+#pragma once
+
+#include "parse.hpp"
+#include "symbol.hpp"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// A handle to a term within a TermStore. Within a single
+/// store, two terms are structurally equal iff their ids are
+/// equal.
+using TermId = uint32_t;
+
+/// An arena of hash-consed terms. Every distinct (head,
+/// children) combination is stored exactly once, so equality
+/// is an integer compare and subterms are shared between every
+/// term which contains them. Terms may be made and read from
+/// several threads at once, so long as no new symbols are
+/// interned meanwhile.
+class TermStore {
+public:
+  /// Constructs an empty store
+  TermStore();
+
+  /// A single interned node
+  struct Node {
+    /// The symbol at the root of this term
+    SymbolId head;
+
+    /// The offset of this node's first child in the child arena
+    uint32_t first_child;
+
+    /// The number of children of this node
+    uint32_t arity;
+
+    /// Structural hash of this node
+    size_t hash;
+
+    /// Cached facts about the whole subterm (see Flags)
+    uint8_t flags;
+
+    /// The number of nodes in the whole subterm, counting
+    /// shared subterms once per occurrence
+    uint32_t weight;
+  };
+
+  /// Facts cached per node, so that substitution and reduction
+  /// can skip subterms they would not change
+  enum Flags : uint8_t {
+    HAS_VARIABLE = 1, /// A variable symbol occurs (not ground)
+    HAS_REPLACE = 2,  /// A REPLACE node occurs
+  };
+
+  /// Returns the id of the term with the given head and
+  /// children, creating it iff it does not already exist
+  TermId make(const SymbolId &_head,
+              const std::vector<TermId> &_children = {});
+
+  /// Equivalent to the above, but interns the head text first
+  TermId make(const std::string &_head,
+              const std::vector<TermId> &_children = {});
+
+  /// Interns a (parsed) AST
+  TermId intern(const ASTNode &_node);
+
+  /// Rebuilds an AST from an interned term
+  ASTNode to_ast(const TermId &_id) const;
+
+  /// Gets the node behind an id
+  const Node &node(const TermId &_id) const;
+
+  /// Gets the head symbol of a term
+  SymbolId head(const TermId &_id) const;
+
+  /// Gets the head text of a term
+  const std::string &text(const TermId &_id) const;
+
+  /// Gets the children of a term
+  std::span<const TermId> children(const TermId &_id) const;
+
+  /// True iff _what occurs as a subterm of _in
+  bool contains(const TermId &_in, const TermId &_what) const;
+
+  /// True iff a subterm of _in has the head _head
+  bool contains_symbol(const TermId &_in,
+                       const SymbolId &_head) const;
+
+  /// Returns _in, but with every occurrence of _to_replace
+  /// replaced with _replace_with
+  TermId replace(const TermId &_in, const TermId &_to_replace,
+                 const TermId &_replace_with);
+
+  /// Equivalent to repeatedly single-replacing the term
+  TermId replace(const TermId &_in,
+                 const std::list<std::pair<TermId, TermId>>
+                     &_replacements);
+
+  /// Returns _schema with every variable symbol (see
+  /// SymbolTable::variable) replaced by its entry in _bindings.
+  /// This is a single pass with O(1) lookup per variable, and
+  /// ground subterms are returned as-is.
+  TermId instantiate(const TermId &_schema,
+                     std::span<const TermId> _bindings);
+
+  /// True iff no variable symbol occurs in the term
+  bool is_ground(const TermId &_id) const;
+
+  /// The number of nodes in the term, as if it were a tree
+  uint32_t weight(const TermId &_id) const;
+
+  /// Recursively apply all beta reductions (REPLACE nodes)
+  /// ALREADY present in the term. Subterms without any are
+  /// returned as-is.
+  TermId beta_star(const TermId &_in);
+
+  /// Writes a term as an s-expression
+  void print(std::ostream &_strm, const TermId &_id) const;
+
+  /// Returns a term as an s-expression
+  std::string to_string(const TermId &_id) const;
+
+  /// The number of distinct terms stored
+  size_t size() const noexcept;
+
+protected:
+  /// Finds an existing node. The caller must hold mutex.
+  std::optional<TermId>
+  find(const size_t &_hash, const SymbolId &_head,
+       const std::vector<TermId> &_children) const;
+
+  /// Nodes and children are stored in chunks of 2^chunk_bits
+  /// entries. A chunk never moves once allocated, so readers
+  /// need no lock while make appends.
+  constexpr static uint32_t chunk_bits = 16;
+
+  /// The number of entries in a chunk
+  constexpr static uint32_t chunk_size = 1u << chunk_bits;
+
+  /// All nodes, indexed by TermId, in chunks
+  std::vector<std::unique_ptr<Node[]>> node_chunks;
+
+  /// The number of nodes
+  std::atomic<uint32_t> n_nodes = 0;
+
+  /// The children of all nodes, in chunks. The children of a
+  /// single node are contiguous within one chunk.
+  std::vector<std::unique_ptr<TermId[]>> child_chunks;
+
+  /// The offset of the next free child entry
+  uint32_t n_children = 0;
+
+  /// Maps structural hashes to the nodes which have them
+  std::unordered_multimap<size_t, TermId> table;
+
+  /// Guards table and all appends. Lookups take it shared.
+  mutable std::shared_mutex mutex;
+
+  /// Rebuilds _in with new children, reusing _in if none of
+  /// them changed
+  TermId rebuild(const TermId &_in,
+                 const std::vector<TermId> &_children);
+};
+
+/// The term store shared by everything in this process
+extern TermStore term_store;
@@ -0,0 +1,124 @@
+/**
+ * @brief A work-stealing thread pool for parallel proof search
+ */
+
+#include "thread_pool.hpp"
+
+/// The pool whose worker is the current thread, if any
+thread_local const WorkStealingPool *current_pool = nullptr;
+
+/// The queue of the current thread within current_pool
+thread_local size_t current_queue = 0;
+
+void Cancellation::cancel() noexcept {
+  raised.store(true, std::memory_order_release);
+}
+
+bool Cancellation::cancelled() const noexcept {
+  for (const Cancellation *c = this; c != nullptr;
+       c = c->parent) {
+    if (c->raised.load(std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+WorkStealingPool::WorkStealingPool(const size_t &_threads) {
+  for (size_t i = 0; i <= _threads; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < _threads; ++i) {
+    threads.emplace_back([this, i]() { work(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock(sleep_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+size_t WorkStealingPool::size() const noexcept {
+  return threads.size();
+}
+
+size_t WorkStealingPool::own_queue() const noexcept {
+  if (current_pool == this) {
+    return current_queue;
+  }
+  return threads.size();
+}
+
+void WorkStealingPool::submit(Task _task) {
+  {
+    auto &queue = *queues[own_queue()];
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(_task));
+  }
+  ++pending;
+
+  // Taking the lock means no worker is between checking for
+  // tasks and sleeping, so it cannot miss this
+  { std::lock_guard lock(sleep_mutex); }
+  wake.notify_one();
+}
+
+bool WorkStealingPool::run_one(const size_t &_self) {
+  Task task;
+
+  // Newest from our own queue
+  {
+    auto &queue = *queues[_self];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+  }
+
+  // Else, oldest from someone else's
+  for (size_t i = 1; !task && i < queues.size(); ++i) {
+    auto &queue = *queues[(_self + i) % queues.size()];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+  --pending;
+  task();
+  return true;
+}
+
+void WorkStealingPool::help_until(
+    const std::function<bool()> &_done) {
+  const size_t self = own_queue();
+  while (!_done()) {
+    if (!run_one(self)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void WorkStealingPool::work(const size_t &_index) {
+  current_pool = this;
+  current_queue = _index;
+  while (!stopping) {
+    if (run_one(_index)) {
+      continue;
+    }
+    std::unique_lock lock(sleep_mutex);
+    wake.wait(lock,
+              [this]() { return stopping || pending > 0; });
+  }
+}
@@ -0,0 +1,100 @@
+/**
+ * @brief A work-stealing thread pool for parallel proof search
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A flag which can be raised to stop a group of tasks. It also
+/// counts as raised whenever its parent is, so cancelling a
+/// task cancels everything it spawned.
+struct Cancellation {
+  /// The group this one was spawned from, if any
+  const Cancellation *parent = nullptr;
+
+  /// Set by cancel
+  std::atomic<bool> raised = false;
+
+  /// Stops this group and every group spawned from it
+  void cancel() noexcept;
+
+  /// True iff this or any ancestor has been cancelled
+  bool cancelled() const noexcept;
+};
+
+/// A fixed set of worker threads, each with its own deque of
+/// tasks. A worker runs its newest task first (keeping its
+/// working set warm) and, when it runs out, steals the oldest
+/// task of some other worker (which is likely the largest).
+class WorkStealingPool {
+public:
+  /// A unit of work
+  using Task = std::function<void()>;
+
+  /// Starts _threads workers
+  explicit WorkStealingPool(const size_t &_threads);
+
+  /// Stops and joins all workers. Queued tasks are dropped.
+  ~WorkStealingPool();
+
+  /// The number of worker threads
+  size_t size() const noexcept;
+
+  /// Queues a task. From a worker of this pool, it goes on that
+  /// worker's own deque; otherwise, on a shared one.
+  void submit(Task _task);
+
+  /// Runs queued tasks on the calling thread until _done
+  /// returns true. A task which waits on others must use this
+  /// rather than blocking, or the pool may deadlock.
+  void help_until(const std::function<bool()> &_done);
+
+protected:
+  /// A lockable deque of tasks
+  struct Queue {
+    /// Guards tasks
+    std::mutex mutex;
+
+    /// The tasks, oldest first
+    std::deque<Task> tasks;
+  };
+
+  /// The queue the calling thread owns: its own if it is a
+  /// worker of this pool, else the shared one
+  size_t own_queue() const noexcept;
+
+  /// Runs one task: the newest from queue _self if there is
+  /// one, else the oldest from any other. Returns false iff
+  /// there was nothing to run.
+  bool run_one(const size_t &_self);
+
+  /// The body of worker _index
+  void work(const size_t &_index);
+
+  /// One queue per worker, then the shared one
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  /// The workers
+  std::vector<std::thread> threads;
+
+  /// The number of queued tasks
+  std::atomic<size_t> pending = 0;
+
+  /// Set once the pool is being destroyed
+  std::atomic<bool> stopping = false;
+
+  /// Guards sleeping workers
+  std::mutex sleep_mutex;
+
+  /// Wakes sleeping workers when a task arrives
+  std::condition_variable wake;
+};
@@ -0,0 +1,52 @@
+/*
+Tests the order of best-first search in the verily src code
+*/
+
+#include "../src/core.hpp"
+#include <cassert>
+
+/// Proves g by best-first search, where rule a (declared first)
+/// ends with _a and rule b with _b, and returns the name of the
+/// rule used
+std::string prove(const std::string &_a,
+                  const std::string &_b) {
+  const std::string text =
+      "rule a: given p deduce g" + _a + ";\n" +
+      "rule b: given q deduce g" + _b + ";\n" +
+      "axiom: p;\naxiom: q;\ntheorem: g;\n";
+  Core core;
+  core.best_first = true;
+  for (const auto &stmt :
+       Parser(lex_text(text, null_fp)).parse().children) {
+    if (stmt.text != "NULL") {
+      core.process_statement(stmt, null_fp);
+    }
+  }
+  assert(!core.saw_error);
+  assert(core.proven_theorems.size() == 1);
+
+  const auto thm =
+      core.im.get_theorem(*core.proven_theorems.begin());
+  return core.im.get_rule(thm.rule_index).name.value();
+}
+
+int main() {
+  // Ties go to the rule declared first
+  assert(prove("", "") == "a");
+
+  // Otherwise the cheaper rule is used
+  assert(prove(" cost 10", "") == "b");
+  assert(prove("", " cost 10") == "a");
+  assert(prove(" cost 3", " cost 2") == "b");
+
+  // A cost must be a number
+  bool threw = false;
+  try {
+    prove(" cost x", "");
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  assert(threw);
+
+  return 0;
+}
@@ -0,0 +1,63 @@
+/*
+Tests checking serialized proofs in the verily src code
+*/
+
+#include "../src/checker.hpp"
+#include <cassert>
+#include <sstream>
+
+/// True iff checking _text against _core throws
+bool rejects(const Core &_core, const std::string &_text) {
+  try {
+    ProofChecker(_core).check(ProofChecker::read(_text).at(0));
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+int main() {
+  const std::string text = "rule succ:\n"
+                           "  over x\n"
+                           "  given x in N\n"
+                           "  deduce s(x) in N\n"
+                           ";\n"
+                           "axiom: z in N;\n"
+                           "theorem: s(s(z)) in N;\n";
+  Core core;
+  for (const auto &stmt :
+       Parser(lex_text(text, null_fp)).parse().children) {
+    if (stmt.text != "NULL") {
+      core.process_statement(stmt, null_fp);
+    }
+  }
+  assert(core.proven_theorems.size() == 1);
+
+  // A proof written by the prover checks
+  std::stringstream written;
+  core.write_proof_dag(written, *core.proven_theorems.begin());
+  const auto proofs = ProofChecker::read(written.str());
+  assert(proofs.size() == 1);
+  const TermId thm = ProofChecker(core).check(proofs[0]);
+  assert(core.im.has(thm) ==
+         (int)*core.proven_theorems.begin());
+
+  // Bad axioms, bad conclusions and forward references do not
+  assert(rejects(core, "(proof (step 0 (axiom (in q N)))"
+                       " (result 0))"));
+  assert(rejects(core, "(proof (step 0 (axiom (in z N)))"
+                       " (step 1 (theorem (in (s q) N)"
+                       " (rule_application (rule succ)"
+                       " (premises 0)))) (result 1))"));
+  assert(rejects(core, "(proof (step 1 (theorem (in (s z) N)"
+                       " (rule_application (rule succ)"
+                       " (premises 0))))"
+                       " (step 0 (axiom (in z N)))"
+                       " (result 1))"));
+  assert(!rejects(core, "(proof (step 0 (axiom (in z N)))"
+                        " (step 1 (theorem (in (s z) N)"
+                        " (rule_application (rule succ)"
+                        " (premises 0)))) (result 1))"));
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+/*
+Tests term indexing in the verily src code
+*/
+
+#include "../src/index.hpp"
+#include "../src/parse.hpp"
+#include "../src/term.hpp"
+#include <cassert>
+
+int main() {
+  const std::set<SymbolId> vars = {symbols.intern("p"),
+                                   symbols.intern("q")};
+
+  // 0: p and q, 1: not p, 2: p, 3: f(a)
+  DiscriminationTree tree;
+  tree.insert(term_store.intern(ASTNode(
+                  "and", {ASTNode("p"), ASTNode("q")})),
+              vars, 0);
+  tree.insert(term_store.intern(ASTNode("not", {ASTNode("p")})),
+              vars, 1);
+  tree.insert(term_store.intern(ASTNode("p")), vars, 2);
+  tree.insert(term_store.intern(ASTNode("f", {ASTNode("a")})),
+              vars, 3);
+
+  assert(tree.retrieve_generalizations(term_store.intern(
+             ASTNode("and", {ASTNode("x"), ASTNode("y")}))) ==
+         std::vector<size_t>({0, 2}));
+  assert(tree.retrieve_generalizations(term_store.intern(
+             ASTNode("not", {ASTNode("x")}))) ==
+         std::vector<size_t>({1, 2}));
+  assert(tree.retrieve_generalizations(term_store.intern(
+             ASTNode("f", {ASTNode("a")}))) ==
+         std::vector<size_t>({2, 3}));
+  assert(tree.retrieve_generalizations(term_store.intern(
+             ASTNode("f", {ASTNode("b")}))) ==
+         std::vector<size_t>({2}));
+
+  // Ground terms, retrieved by patterns
+  // 0: a and b, 1: not a, 2: a and not a, 3: f(a)
+  const ASTNode not_a("not", {ASTNode("a")});
+  DiscriminationTree known;
+  known.insert(term_store.intern(ASTNode(
+                   "and", {ASTNode("a"), ASTNode("b")})),
+               {}, 0);
+  known.insert(term_store.intern(not_a), {}, 1);
+  known.insert(term_store.intern(
+                   ASTNode("and", {ASTNode("a"), not_a})),
+               {}, 2);
+  known.insert(term_store.intern(ASTNode("f", {ASTNode("a")})),
+               {}, 3);
+
+  assert(known.retrieve_unifiable(
+             term_store.intern(ASTNode(
+                 "and", {ASTNode("p"), ASTNode("q")})),
+             vars) == std::vector<size_t>({0, 2}));
+  const ASTNode not_q("not", {ASTNode("q")});
+  assert(known.retrieve_unifiable(
+             term_store.intern(
+                 ASTNode("and", {ASTNode("p"), not_q})),
+             vars) == std::vector<size_t>({2}));
+  assert(known.retrieve_unifiable(
+             term_store.intern(ASTNode("p")), vars) ==
+         std::vector<size_t>({0, 1, 2, 3}));
+
+  return 0;
+}
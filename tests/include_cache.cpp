@@ -0,0 +1,143 @@
+/*
+Tests skipping and caching included files in the verily src code
+*/
+
+#include "../src/snapshot.hpp"
+#include <cassert>
+#include <fstream>
+#include <sstream>
+
+/// Writes _text to the file at _fp
+void write(const std::filesystem::path &_fp,
+           const std::string &_text) {
+  std::ofstream f(_fp);
+  assert(f.is_open());
+  f << _text;
+}
+
+/// The number of entries in the cache at _dir
+size_t entries(const std::filesystem::path &_dir) {
+  size_t out = 0;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(_dir)) {
+    out += entry.is_regular_file();
+  }
+  return out;
+}
+
+/// Every proof _core printed, in order
+std::string proofs(const Core &_core) {
+  std::stringstream out;
+  for (const auto &index : _core.proven_theorems) {
+    _core.write_proof(out, index);
+    out << "\n";
+  }
+  return out.str();
+}
+
+int main() {
+  const auto dir = std::filesystem::temp_directory_path() /
+                   "verily_include_cache_test";
+  const auto cache = dir / "cache";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  // A diamond: both a and b include base
+  write(dir / "base.verily", "rule:\n"
+                             "  over x\n"
+                             "  given x in N\n"
+                             "  deduce s(x) in N\n"
+                             ";\n"
+                             "axiom: z in N;\n"
+                             "theorem: s(z) in N;\n");
+  write(dir / "a.verily", "include \"base.verily\";\n"
+                          "theorem: s(s(z)) in N;\n");
+  write(dir / "b.verily", "include \"base.verily\";\n"
+                          "theorem: s(s(s(z))) in N;\n");
+  write(dir / "main.verily", "include \"a.verily\";\n"
+                             "include \"b.verily\";\n");
+
+  // Within a run, base is only done once
+  Core plain;
+  plain.do_file(dir / "main.verily");
+  assert(!plain.saw_error);
+  assert(plain.im.rules.size() == 1);
+  assert(plain.proven_theorems.size() == 3);
+  assert(plain.included_files.size() == 4);
+  assert(plain.file_log.size() == 5);
+
+  // The first cached run fills the cache: a, base (within a)
+  // and b
+  Core filling;
+  filling.include_cache = cache;
+  filling.do_file(dir / "main.verily");
+  assert(proofs(filling) == proofs(plain));
+  assert(entries(cache) == 3);
+
+  // The next hits, and adds nothing
+  Core hitting;
+  hitting.include_cache = cache;
+  hitting.do_file(dir / "main.verily");
+  assert(hitting.im.rules.size() == 1);
+  assert(proofs(hitting) == proofs(plain));
+  assert(hitting.included_files == plain.included_files);
+  assert(entries(cache) == 3);
+
+  // A changed file misses, but the rest still hit
+  write(dir / "b.verily", "include \"base.verily\";\n"
+                          "theorem: s(s(s(s(z)))) in N;\n");
+  Core changed;
+  changed.include_cache = cache;
+  changed.do_file(dir / "main.verily");
+  assert(changed.im.rules.size() == 1);
+  assert(changed.proven_theorems.size() == 3);
+  assert(entries(cache) == 4);
+
+  // As does the same file from another state
+  Core other;
+  other.include_cache = cache;
+  for (const auto &stmt :
+       Parser(lex_text("axiom: q in N;\n"
+                       "include \"a.verily\";\n",
+                       dir / "other.verily"))
+           .parse()
+           .children) {
+    if (stmt.text != "NULL") {
+      other.process_statement(stmt, dir / "other.verily");
+    }
+  }
+  assert(other.proven_theorems.size() == 2);
+  assert(entries(cache) == 6);
+
+  // Only checking skips theorems, so it leaves the cache alone
+  std::filesystem::remove_all(cache);
+  Core checking;
+  checking.include_cache = cache;
+  checking.check_only = true;
+  checking.do_file(dir / "main.verily");
+  assert(checking.proven_theorems.empty());
+  assert(!std::filesystem::exists(cache));
+
+  Core after_checking;
+  after_checking.include_cache = cache;
+  after_checking.do_file(dir / "main.verily");
+  assert(after_checking.proven_theorems.size() == 3);
+
+  // A loaded snapshot remembers its files, so they are not done
+  // again
+  Core library;
+  library.do_file(dir / "base.verily");
+  const auto fp = dir / "base.snap";
+  save_snapshot(library, fp);
+  assert(snapshot_files(fp) == library.file_log);
+
+  Core loaded;
+  load_snapshot(loaded, fp);
+  loaded.do_file(dir / "main.verily");
+  assert(!loaded.saw_error);
+  assert(loaded.im.rules.size() == 1);
+  assert(loaded.proven_theorems.size() == 3);
+
+  std::filesystem::remove_all(dir);
+  return 0;
+}
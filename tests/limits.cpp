@@ -0,0 +1,97 @@
+/*
+Tests that resource limits stop every search strategy in the
+verily src code
+*/
+
+#include "../src/core.hpp"
+#include <cassert>
+#include <chrono>
+
+/// Conjunction blows up forward search, and left and right
+/// blow up backward search, since no goal can be proven
+const std::string text = "rule conj:\n"
+                         "  over a, b\n"
+                         "  given a, b\n"
+                         "  deduce a and b\n"
+                         ";\n"
+                         "rule left:\n"
+                         "  over x given l(x) deduce x;\n"
+                         "rule right:\n"
+                         "  over x given r(x) deduce x;\n"
+                         "axiom: p;\n"
+                         "axiom: q;\n";
+
+/// Proves zzz by _statement under _core's strategy, asserting
+/// that it gives up because of _limit, and soon after
+void expect_limit(Core &_core, const std::string &_statement,
+                  const InferenceMaker::Limit &_limit) {
+  _core.pass_limit = 1000;
+  for (const auto &stmt :
+       Parser(lex_text(text + _statement + ": zzz;\n", null_fp))
+           .parse()
+           .children) {
+    if (stmt.text != "NULL") {
+      const auto start = std::chrono::steady_clock::now();
+      _core.process_statement(stmt, null_fp);
+      assert(std::chrono::steady_clock::now() - start <
+             std::chrono::seconds(2));
+    }
+  }
+  assert(_core.saw_error);
+  assert(_core.im.limit_hit == _limit);
+  assert(_core.proven_theorems.empty());
+}
+
+int main() {
+  const auto time = std::chrono::milliseconds(200);
+
+  // Forward search, joining, joining in parallel and by rete
+  for (const size_t threads : {1, 4}) {
+    for (const bool use_rete : {false, true}) {
+      Core by_time;
+      by_time.im.threads = threads;
+      by_time.im.use_rete = use_rete;
+      by_time.im.limits.time = time;
+      expect_limit(by_time, "prove_forward",
+                   InferenceMaker::TIME_LIMIT);
+
+      // Theorems not yet added count too, so none are added
+      // past the limit
+      Core by_theorems;
+      by_theorems.im.threads = threads;
+      by_theorems.im.use_rete = use_rete;
+      by_theorems.im.limits.theorems = 1000;
+      expect_limit(by_theorems, "prove_forward",
+                   InferenceMaker::THEOREM_LIMIT);
+      assert(by_theorems.im.known.size() <= 2 + 1000);
+    }
+  }
+
+  // Backward search, in each order
+  for (const int strategy : {0, 1, 2, 3}) {
+    for (const bool by_nodes : {false, true}) {
+      Core core;
+      core.deepen = strategy == 1;
+      core.best_first = strategy == 2;
+      core.im.threads = strategy == 3 ? 4 : 1;
+      if (by_nodes) {
+        core.im.limits.nodes = 10000;
+      } else {
+        core.im.limits.time = time;
+      }
+      expect_limit(core, "theorem",
+                   by_nodes ? InferenceMaker::NODE_LIMIT
+                            : InferenceMaker::TIME_LIMIT);
+    }
+  }
+
+  // Alternation, starting either way
+  for (const auto &statement : {"theorem", "prove_forward"}) {
+    Core core;
+    core.im.enable_alternation = true;
+    core.im.limits.time = time;
+    expect_limit(core, statement, InferenceMaker::TIME_LIMIT);
+  }
+
+  return 0;
+}
@@ -3,6 +3,7 @@ Tests pattern matching in the verily src code
 */
 
 #include "../src/inference.hpp"
+#include "../src/match.hpp"
 #include "../src/parse.hpp"
 #include <cassert>
 
@@ -30,5 +31,40 @@ int main() {
       // other junk
       free_variables, replacements));
 
+  // The same, but via compiled match programs sharing
+  // variables: f(a) then a == c
+  const TermId a = term_store.make(symbols.variable(0));
+  const TermId c = term_store.make(symbols.variable(1));
+  const auto first =
+      MatchProgram::compile(term_store.make("f", {a}));
+  const auto second =
+      MatchProgram::compile(term_store.make("==", {a, c}));
+
+  Bindings bindings = no_bindings();
+  assert(first.run(
+      term_store.intern(ASTNode("f", {ASTNode("x")})),
+      bindings));
+  assert(bindings[0] == term_store.intern(ASTNode("x")));
+  assert(!second.run(
+      term_store.intern(
+          ASTNode("==", {ASTNode("y"), ASTNode("z")})),
+      bindings));
+
+  bindings = no_bindings();
+  assert(first.run(
+      term_store.intern(ASTNode("f", {ASTNode("x")})),
+      bindings));
+  assert(second.run(
+      term_store.intern(
+          ASTNode("==", {ASTNode("x"), ASTNode("z")})),
+      bindings));
+  assert(bindings[1] == term_store.intern(ASTNode("z")));
+
+  // Instantiating a schema is a single pass
+  assert(term_store.instantiate(term_store.make("g", {c, a}),
+                                bindings) ==
+         term_store.intern(
+             ASTNode("g", {ASTNode("z"), ASTNode("x")})));
+
   return 0;
 }
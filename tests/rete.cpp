@@ -0,0 +1,47 @@
+/*
+Tests the incremental match network in the verily src code
+*/
+
+#include "../src/rete.hpp"
+#include "../src/term.hpp"
+#include <cassert>
+
+int main() {
+  // Requirements: p(x), q(x, y)
+  const TermId x = term_store.make(symbols.variable(0));
+  const TermId y = term_store.make(symbols.variable(1));
+  const std::vector<MatchProgram> programs = {
+      MatchProgram::compile(term_store.make("p", {x})),
+      MatchProgram::compile(term_store.make("q", {x, y}))};
+
+  const TermId a = term_store.make("a");
+  const TermId b = term_store.make("b");
+
+  ReteNetwork rete;
+  std::vector<ReteNetwork::Match> matches;
+
+  // Facts added before the rule are matched when it arrives
+  rete.add_fact(0, term_store.make("q", {a, b}), matches);
+  rete.add_rule(7, programs, matches);
+  assert(matches.empty());
+
+  // The match completes when its last fact arrives
+  rete.add_fact(1, term_store.make("p", {a}), matches);
+  assert(matches.size() == 1);
+  assert(matches[0].rule == 7);
+  assert(matches[0].premises == std::vector<size_t>({1, 0}));
+  assert(matches[0].bindings[0] == a);
+  assert(matches[0].bindings[1] == b);
+
+  // Inconsistent bindings never match, and old matches are not
+  // produced again
+  matches.clear();
+  rete.add_fact(2, term_store.make("q", {b, a}), matches);
+  assert(matches.empty());
+  rete.add_fact(3, term_store.make("q", {a, a}), matches);
+  assert(matches.size() == 1);
+  assert(matches[0].premises == std::vector<size_t>({1, 3}));
+  assert(rete.n_facts() == 4);
+
+  return 0;
+}
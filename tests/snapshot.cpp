@@ -0,0 +1,53 @@
+/*
+Tests saving and loading snapshots in the verily src code
+*/
+
+#include "../src/snapshot.hpp"
+#include <cassert>
+#include <sstream>
+
+int main() {
+  const std::string text = "rule:\n"
+                           "  over x\n"
+                           "  given x in N\n"
+                           "  deduce s(x) in N\n"
+                           "  cost 3\n"
+                           ";\n"
+                           "axiom: z in N;\n"
+                           "theorem: s(s(z)) in N;\n";
+  Core original;
+  for (const auto &stmt :
+       Parser(lex_text(text, null_fp)).parse().children) {
+    if (stmt.text != "NULL") {
+      original.process_statement(stmt, null_fp);
+    }
+  }
+  assert(!original.saw_error);
+  assert(original.proven_theorems.size() == 1);
+
+  const auto fp = std::filesystem::temp_directory_path() /
+                  "verily_snapshot_test.bin";
+  save_snapshot(original, fp);
+
+  // Everything comes back, and proves the same way
+  Core loaded;
+  load_snapshot(loaded, fp);
+  assert(loaded.im.rules.size() == original.im.rules.size());
+  assert(loaded.im.rules[0].cost == 3);
+  assert(loaded.im.known.size() == original.im.known.size());
+  assert(loaded.axioms == original.axioms);
+  assert(loaded.proven_theorems == original.proven_theorems);
+
+  const size_t proven = *original.proven_theorems.begin();
+  std::stringstream expected, got;
+  original.write_proof(expected, proven);
+  loaded.write_proof(got, proven);
+  assert(expected.str() == got.str());
+
+  // Loading again reuses the theorems already known
+  load_snapshot(loaded, fp);
+  assert(loaded.im.known.size() == original.im.known.size());
+
+  std::filesystem::remove(fp);
+  return 0;
+}
@@ -0,0 +1,52 @@
+/*
+Tests hash-consing in the verily term store
+*/
+
+#include "../src/parse.hpp"
+#include "../src/term.hpp"
+#include <cassert>
+
+int main() {
+  TermStore store;
+
+  // Identical subterms share one id
+  const TermId a = store.intern(
+      ASTNode("and", {ASTNode("f", {ASTNode("x")}),
+                      ASTNode("f", {ASTNode("x")})}));
+  const TermId b = store.intern(
+      ASTNode("and", {ASTNode("f", {ASTNode("x")}),
+                      ASTNode("f", {ASTNode("x")})}));
+  assert(a == b);
+  assert(store.children(a)[0] == store.children(a)[1]);
+  assert(store.size() == 3);
+  assert(store.to_ast(a) ==
+         ASTNode("and", {ASTNode("f", {ASTNode("x")}),
+                         ASTNode("f", {ASTNode("x")})}));
+
+  // Replacement reuses existing terms
+  const TermId x = store.make("x");
+  const TermId y = store.make("y");
+  const TermId replaced = store.replace(a, x, y);
+  assert(replaced != a);
+  assert(store.replace(replaced, y, x) == a);
+
+  // Beta reduction
+  const TermId beta =
+      store.make("REPLACE", {store.make("f", {x}), x, y});
+  assert(store.beta_star(beta) == store.make("f", {y}));
+
+  // Unchanged subterms are shared, not rebuilt
+  const size_t before = store.size();
+  assert(store.beta_star(a) == a);
+  assert(store.replace(a, y, x) == a);
+  assert(store.instantiate(a, std::vector<TermId>{}) == a);
+  assert(store.size() == before);
+  assert(store.is_ground(a));
+  assert(!store.is_ground(store.make(symbols.variable(0))));
+
+  // Weights count shared subterms once per occurrence
+  assert(store.weight(x) == 1);
+  assert(store.weight(a) == 5);
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*
+Tests the work-stealing thread pool in the verily src code
+*/
+
+#include "../src/thread_pool.hpp"
+#include <atomic>
+#include <cassert>
+
+int main() {
+  WorkStealingPool pool(4);
+  assert(pool.size() == 4);
+
+  // Tasks run, and can themselves spawn and wait on tasks
+  std::atomic<size_t> remaining = 8, leaves = 0;
+  for (int i = 0; i < 8; ++i) {
+    pool.submit([&]() {
+      std::atomic<size_t> children = 16;
+      for (int j = 0; j < 16; ++j) {
+        pool.submit([&]() {
+          ++leaves;
+          --children;
+        });
+      }
+      pool.help_until([&]() { return children == 0; });
+      --remaining;
+    });
+  }
+  pool.help_until([&]() { return remaining == 0; });
+  assert(leaves == 8 * 16);
+
+  // Cancelling a group cancels the groups spawned from it
+  Cancellation outer, inner;
+  inner.parent = &outer;
+  assert(!inner.cancelled());
+  outer.cancel();
+  assert(inner.cancelled());
+  assert(!Cancellation().cancelled());
+
+  return 0;
+}
@@ -2,21 +2,25 @@
  * @brief Tests the inference maker object
  */
 
+#include "src/checker.hpp"
 #include "src/core.hpp"
 #include "src/inference.hpp"
 #include "src/parse.hpp"
+#include "src/snapshot.hpp"
 #include <cassert>
 #include <chrono>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 const std::string version = "0.0.1";
 
 int main(int argc, char *argv[]) {
   std::filesystem::path fp = null_fp;
+  std::filesystem::path load_fp, save_fp, check_fp;
   Core verily;
   for (int i = 1; i < argc; ++i) {
     const std::string arg = argv[i];
@@ -30,6 +34,71 @@ int main(int argc, char *argv[]) {
       assert(i + 1 < argc);
       ++i;
       verily.pass_limit = std::stoi(argv[i]);
+    } else if (arg == "--back_steps") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.backward_budget = std::stoull(argv[i]);
+    } else if (arg == "--fwd_passes") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.forward_budget = std::stoi(argv[i]);
+    } else if (arg == "--timeout") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.limits.time =
+          std::chrono::milliseconds(std::stoull(argv[i]));
+    } else if (arg == "--theorems") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.limits.theorems = std::stoull(argv[i]);
+    } else if (arg == "--nodes") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.limits.nodes = std::stoull(argv[i]);
+    } else if (arg == "--memory") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.limits.memory = std::stoull(argv[i]) << 20;
+    } else if (arg == "--global_limit") {
+      verily.global_limits = !verily.global_limits;
+    } else if (arg == "--proof_format") {
+      assert(i + 1 < argc);
+      ++i;
+      const std::string format = argv[i];
+      if (format != "tree" && format != "dag") {
+        std::cerr << "Unknown proof format " << format << "\n";
+        return 2;
+      }
+      verily.dag_proofs = format == "dag";
+    } else if (arg == "--load") {
+      assert(i + 1 < argc);
+      ++i;
+      load_fp = argv[i];
+    } else if (arg == "--save") {
+      assert(i + 1 < argc);
+      ++i;
+      save_fp = argv[i];
+    } else if (arg == "--cache") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.include_cache = argv[i];
+    } else if (arg == "--check") {
+      assert(i + 1 < argc);
+      ++i;
+      check_fp = argv[i];
+      verily.check_only = true;
+    } else if (arg == "--deepen") {
+      verily.deepen = !verily.deepen;
+    } else if (arg == "--best_first") {
+      verily.best_first = !verily.best_first;
+    } else if (arg == "--threads") {
+      assert(i + 1 < argc);
+      ++i;
+      verily.im.threads = std::stoi(argv[i]);
+    } else if (arg == "--and_parallel") {
+      verily.im.and_parallel = !verily.im.and_parallel;
+    } else if (arg == "--rete") {
+      verily.im.use_rete = !verily.im.use_rete;
     } else if (arg == "--time") {
       verily.time = !verily.time;
     } else if (arg == "--latex") {
@@ -48,7 +117,40 @@ int main(int argc, char *argv[]) {
         " --debug        | false   | Toggles debug mode      \n"
         " --alternate    | false   | Toggles alternation     \n"
         " --pass_limit N | 64      | Sets the depth limit    \n"
+        " --back_steps N | 100000  | Sets the goals examined \n"
+        "                |         | per backward round      \n"
+        " --fwd_passes N | 1       | Sets the passes made per\n"
+        "                |         | forward round           \n"
+        " --timeout MS   | none    | Limits the time per     \n"
+        "                |         | statement               \n"
+        " --theorems N   | none    | Limits the theorems     \n"
+        "                |         | derived per statement   \n"
+        " --nodes N      | none    | Limits the goals        \n"
+        "                |         | examined by backward    \n"
+        "                |         | search per statement    \n"
+        " --memory MB    | none    | Limits the resident     \n"
+        "                |         | memory                  \n"
+        " --global_limit | false   | Toggles applying limits \n"
+        "                |         | to the whole run        \n"
+        " --deepen       | false   | Toggles iterative       \n"
+        "                |         | deepening               \n"
+        " --best_first   | false   | Toggles best-first      \n"
+        "                |         | backward search         \n"
+        " --threads N    | 1       | Sets the number of      \n"
+        "                |         | proof search threads    \n"
+        " --and_parallel | false   | Toggles proving rule    \n"
+        "                |         | requirements at once    \n"
+        " --rete         | false   | Toggles incremental     \n"
+        "                |         | forward matching        \n"
         " --latex        | false   | Prints latex to file    \n"
+        " --load FILE    |         | Starts from a snapshot  \n"
+        " --save FILE    |         | Saves a snapshot at exit\n"
+        " --check FILE   |         | Checks the proofs in    \n"
+        "                |         | FILE instead of proving \n"
+        " --cache DIR    |         | Reuses includes done by \n"
+        "                |         | past runs, kept in DIR  \n"
+        " --proof_format | tree    | Prints proofs as a tree \n"
+        "   tree|dag     |         | or as numbered steps    \n"
         "                                                    \n"
         "You can give it a filepath as an argument, in which \n"
         "case that file will be analyzed. If no filepath is  \n"
@@ -66,6 +168,26 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // Alternation always searches backward depth-first
+  if (verily.im.enable_alternation) {
+    if (verily.deepen) {
+      std::cerr << "WARNING: --deepen is ignored with "
+                   "--alternate\n";
+    }
+    if (verily.best_first) {
+      std::cerr << "WARNING: --best_first is ignored with "
+                   "--alternate\n";
+    }
+    if (verily.im.threads > 1) {
+      std::cerr << "WARNING: With --alternate, --threads only "
+                   "applies to forward passes\n";
+    }
+  }
+
+  if (!load_fp.empty()) {
+    load_snapshot(verily, load_fp);
+  }
+
   std::chrono::high_resolution_clock::time_point start, stop;
   if (fp != null_fp) {
     // File mode
@@ -138,8 +260,37 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (!check_fp.empty()) {
+    std::ifstream f(check_fp);
+    if (!f.is_open()) {
+      std::cerr << "Failed to open proof file\n";
+      return 2;
+    }
+    std::stringstream contents;
+    contents << f.rdbuf();
+
+    const ProofChecker checker(verily);
+    const auto proofs = ProofChecker::read(contents.str());
+    for (const auto &proof : proofs) {
+      try {
+        const TermId thm = checker.check(proof);
+        std::cout << "Checked ";
+        term_store.print(std::cout, thm);
+        std::cout << "\n";
+      } catch (const std::runtime_error &e) {
+        verily.saw_error = true;
+        std::cerr << "ERROR:   Bad proof: " << e.what() << "\n";
+      }
+    }
+  }
+
   for (const auto &index : verily.proven_theorems) {
-    std::cout << verily.proof_to_ast(index) << "\n\n";
+    if (verily.dag_proofs) {
+      verily.write_proof_dag(std::cout, index);
+    } else {
+      verily.write_proof(std::cout, index);
+    }
+    std::cout << "\n\n";
   }
 
   if (verily.time) {
@@ -165,6 +316,10 @@ int main(int argc, char *argv[]) {
     verily.latex(f);
   }
 
+  if (!save_fp.empty()) {
+    save_snapshot(verily, save_fp);
+  }
+
   if (verily.saw_error) {
     return 1;
   }